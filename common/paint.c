@@ -0,0 +1,2177 @@
+#include "paint.h"
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <math.h>
+#include <float.h>
+#include <limits.h>
+#include <time.h>
+
+unsigned int WINDOW_WIDTH = 800;
+unsigned int WINDOW_HEIGHT = 600;
+
+unsigned int FRAMERATE = 60;
+int vsync = 0;
+
+/*
+Arène : la mémoire d'un dessin (primitives et tableaux de points) est découpée séquentiellement dans de gros blocs,
+puis rendue d'un coup quand le dessin est effacé. Les points voisins restent voisins en mémoire.
+*/
+#define ARENA_CHUNK_SIZE (256 * 1024)
+#define ARENA_ALIGNMENT 16
+
+void initArena(Arena* arena) {
+	assert(arena);
+	arena->chunks = NULL;
+}
+
+ArenaChunk* allocArenaChunk(size_t capacity) {
+	ArenaChunk* chunk = (ArenaChunk*) malloc(sizeof(ArenaChunk) + capacity);
+	if (!chunk) {
+		return NULL;
+	}
+	chunk->next = NULL;
+	chunk->capacity = capacity;
+	chunk->used = 0;
+	return chunk;
+}
+
+void* arenaAlloc(Arena* arena, size_t size) {
+	assert(arena);
+	size = (size + ARENA_ALIGNMENT - 1) & ~(size_t) (ARENA_ALIGNMENT - 1);
+	ArenaChunk* chunk = arena->chunks;
+
+	if (size > ARENA_CHUNK_SIZE / 4) {
+		/* Gros tableau : bloc dédié, placé derrière le bloc courant pour ne pas perdre la place qui y reste */
+		ArenaChunk* big = allocArenaChunk(size);
+		if (!big) {
+			return NULL;
+		}
+		big->used = size;
+		if (chunk) {
+			big->next = chunk->next;
+			chunk->next = big;
+		} else {
+			arena->chunks = big;
+		}
+		return big + 1;
+	}
+
+	if (!chunk || chunk->used + size > chunk->capacity) {
+		chunk = allocArenaChunk(ARENA_CHUNK_SIZE);
+		if (!chunk) {
+			return NULL;
+		}
+		chunk->next = arena->chunks;
+		arena->chunks = chunk;
+	}
+	void* data = (unsigned char*) (chunk + 1) + chunk->used;
+	chunk->used += size;
+	return data;
+}
+
+/* Libère toute la mémoire de l'arène : un free() par bloc, quel que soit le nombre de points */
+void clearArena(Arena* arena) {
+	assert(arena);
+	while (arena->chunks) {
+		ArenaChunk* next = arena->chunks->next;
+		free(arena->chunks);
+		arena->chunks = next;
+	}
+}
+
+/* Mémoire réservée par l'arène, en octets */
+size_t arenaBytes(const Arena* arena) {
+	assert(arena);
+	size_t bytes = 0;
+	const ArenaChunk* chunk;
+	for (chunk = arena->chunks; chunk; chunk = chunk->next) {
+		bytes += sizeof(ArenaChunk) + chunk->capacity;
+	}
+	return bytes;
+}
+
+void initPoints(PointArray* array, Arena* arena) {
+	assert(array);
+	assert(arena);
+	array->arena = arena;
+	array->x = NULL;
+	array->y = NULL;
+	array->rgb = NULL;
+	array->count = 0;
+	array->capacity = 0;
+	array->dirty = 1;
+}
+
+int reservePoints(PointArray* array, unsigned int capacity) {
+	assert(array);
+	if (capacity <= array->capacity) {
+		return 1;
+	}
+	/*
+	Les nouveaux tableaux sont pris dans l'arène et les points y sont recopiés. Les anciens tableaux ne sont rendus
+	qu'avec l'arène : avec une capacité qui double, la place perdue reste inférieure à la place utilisée.
+	*/
+	float* x = (float*) arenaAlloc(array->arena, capacity * sizeof(float));
+	float* y = (float*) arenaAlloc(array->arena, capacity * sizeof(float));
+	unsigned char* rgb = (unsigned char*) arenaAlloc(array->arena, 3 * capacity * sizeof(unsigned char));
+	if (!x || !y || !rgb) {
+		return 0;
+	}
+	if (array->count) {
+		memcpy(x, array->x, array->count * sizeof(float));
+		memcpy(y, array->y, array->count * sizeof(float));
+		memcpy(rgb, array->rgb, 3 * array->count * sizeof(unsigned char));
+	}
+	array->x = x;
+	array->y = y;
+	array->rgb = rgb;
+	array->capacity = capacity;
+	return 1;
+}
+
+int addPointToArray(PointArray* array, float x, float y, unsigned char r, unsigned char g, unsigned char b) {
+	assert(array);
+	if (array->count == array->capacity) {
+		/* Tableau plein : on double sa capacité */
+		unsigned int capacity = array->capacity ? 2 * array->capacity : 16;
+		if (!reservePoints(array, capacity)) {
+			return 0;
+		}
+	}
+	unsigned int i = array->count;
+	array->x[i] = x;
+	array->y[i] = y;
+	array->rgb[3 * i] = r;
+	array->rgb[3 * i + 1] = g;
+	array->rgb[3 * i + 2] = b;
+	array->count++;
+	array->dirty = 1;
+	return 1;
+}
+
+Box emptyBox() {
+	Box box = {FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX};
+	return box;
+}
+
+void extendBox(Box* box, float x, float y) {
+	if (x < box->minX) {
+		box->minX = x;
+	}
+	if (x > box->maxX) {
+		box->maxX = x;
+	}
+	if (y < box->minY) {
+		box->minY = y;
+	}
+	if (y > box->maxY) {
+		box->maxY = y;
+	}
+}
+
+int boxesIntersect(const Box* a, const Box* b) {
+	return a->minX <= b->maxX && b->minX <= a->maxX && a->minY <= b->maxY && b->minY <= a->maxY;
+}
+
+void drawPoints(const PointArray* array) {
+	unsigned int i;
+	for (i = 0; i < array->count; ++i) {
+		glColor3ubv(array->rgb + 3 * i);
+		glVertex2f(array->x[i], array->y[i]);
+	}
+}
+
+Primitive* allocPrimitive(Arena* arena, GLenum primitiveType) {
+	/*
+	On prend dans l'arène du dessin un espace mémoire suffisant pour pouvoir stocker une primitive
+	Attention : la fonction arenaAlloc() renvoie un void* qu'il faut impérativement caster en Primitive*.
+	*/
+	Primitive* primitive = (Primitive*) arenaAlloc(arena, sizeof(Primitive));
+	if (!primitive) {
+		return NULL;
+	}
+	primitive->primitiveType = primitiveType;
+	initPoints(&primitive->points, arena);
+	primitive->fileVertices = NULL;
+	primitive->fileCount = 0;
+	primitive->vbo = 0;
+	primitive->vboCount = 0;
+	primitive->lodVbo = 0;
+	primitive->lodCount = 0;
+	primitive->lodLevel = LOD_NONE;
+	primitive->indexVbo = 0;
+	primitive->indexCount = 0;
+	primitive->bounds = emptyBox();
+	primitive->index = 0;
+	primitive->next = NULL;
+	return primitive;
+}
+
+int isCurveType(GLenum primitiveType) {
+	return primitiveType == PRIMITIVE_QUADRATIC_BEZIER || primitiveType == PRIMITIVE_CUBIC_BEZIER
+		|| primitiveType == PRIMITIVE_CATMULL_ROM;
+}
+
+/*
+Agrandit la boîte englobante pour le point i, le dernier ajouté. Une courbe de Bézier reste dans l'enveloppe de ses
+points de contrôle, mais une spline de Catmull-Rom peut en sortir : on y ajoute les points de contrôle de Bézier
+équivalents qui dépendent du nouveau point, P(i-1) ± (P(i) - P(i-2)) / 6.
+*/
+void extendPrimitiveBounds(Primitive* primitive, unsigned int i) {
+	const PointArray* points = &primitive->points;
+	extendBox(&primitive->bounds, points->x[i], points->y[i]);
+	if (primitive->primitiveType == PRIMITIVE_CATMULL_ROM && i > 0) {
+		unsigned int before = i > 1 ? i - 2 : 0;
+		float dx = (points->x[i] - points->x[before]) / 6.f;
+		float dy = (points->y[i] - points->y[before]) / 6.f;
+		extendBox(&primitive->bounds, points->x[i - 1] + dx, points->y[i - 1] + dy);
+		extendBox(&primitive->bounds, points->x[i - 1] - dx, points->y[i - 1] - dy);
+	}
+}
+
+/* Ajoute un point à la primitive en agrandissant sa boîte englobante */
+int addPointToPrimitive(Primitive* primitive, float x, float y, unsigned char r, unsigned char g, unsigned char b) {
+	assert(primitive);
+	if (!addPointToArray(&primitive->points, x, y, r, g, b)) {
+		return 0;
+	}
+	extendPrimitiveBounds(primitive, primitive->points.count - 1);
+	return 1;
+}
+
+unsigned int primitiveVertexCount(const Primitive* primitive) {
+	return primitive->fileVertices ? primitive->fileCount : primitive->points.count;
+}
+
+void primitiveVertex(const Primitive* primitive, unsigned int i, float* x, float* y) {
+	if (primitive->fileVertices) {
+		*x = primitive->fileVertices[i].x;
+		*y = primitive->fileVertices[i].y;
+	} else {
+		*x = primitive->points.x[i];
+		*y = primitive->points.y[i];
+	}
+}
+
+const unsigned char* primitiveColor(const Primitive* primitive, unsigned int i) {
+	return primitive->fileVertices ? &primitive->fileVertices[i].r : primitive->points.rgb + 3 * i;
+}
+
+void initPrimitiveList(PrimitiveList* list) {
+	assert(list);
+	list->head = NULL;
+	list->tail = NULL;
+	list->count = 0;
+}
+
+/* La primitive est ajoutée en queue : elle devient la primitive courante et sera dessinée en dernier */
+void addPrimitive(Primitive* primitive, PrimitiveList* list) {
+	assert(primitive);
+	assert(list);
+	primitive->next = NULL;
+	primitive->index = list->count;
+	if (list->tail) {
+		list->tail->next = primitive;
+	} else {
+		list->head = primitive;
+	}
+	list->tail = primitive;
+	list->count++;
+}
+
+/* Double de l'aire signée du triangle abc (points x, y entrelacés), positif s'il tourne dans le sens trigonométrique */
+float triangleArea2(const float* points, unsigned int a, unsigned int b, unsigned int c) {
+	return (points[2 * b] - points[2 * a]) * (points[2 * c + 1] - points[2 * a + 1])
+		- (points[2 * b + 1] - points[2 * a + 1]) * (points[2 * c] - points[2 * a]);
+}
+
+/*
+Triangulation d'un polygone simple, convexe ou non, par découpe d'oreilles : on retire un à un les sommets convexes
+dont le triangle ne contient aucun autre sommet restant. Seuls les sommets rentrants peuvent être dans ce triangle, et
+retirer une oreille n'en crée pas : un polygone convexe est découpé en O(count), un polygone concave en O(count²) à
+O(count³). points : x, y entrelacés ; triangles : 3 (count - 2) indices au plus. Les sommets alignés sont retirés
+sans triangle. Un polygone qui se recoupe peut ne plus avoir d'oreille : on revient alors à l'éventail depuis le
+premier sommet, comme le découpage de GL_POLYGON par les pilotes. Renvoie le nombre d'indices écrits.
+*/
+unsigned int triangulatePolygon(const float* points, unsigned int count, unsigned int* triangles) {
+	unsigned int i, j, written = 0;
+	if (count < 3) {
+		return 0;
+	}
+	assert(points);
+	assert(triangles);
+	unsigned int* links = (unsigned int*) malloc(3 * count * sizeof(unsigned int));
+	if (links) {
+		unsigned int* previous = links;
+		unsigned int* next = links + count;
+		unsigned int* reflex = links + 2 * count;
+		float area = 0;
+		for (i = 0; i < count; ++i) {
+			previous[i] = i ? i - 1 : count - 1;
+			next[i] = i + 1 < count ? i + 1 : 0;
+			area += points[2 * i] * points[2 * next[i] + 1] - points[2 * next[i]] * points[2 * i + 1];
+		}
+		float orientation = area < 0 ? -1.f : 1.f;
+		unsigned int nbReflex = 0;
+		for (i = 0; i < count; ++i) {
+			reflex[i] = orientation * triangleArea2(points, previous[i], i, next[i]) < 0;
+			nbReflex += reflex[i];
+		}
+		unsigned int remaining = count, tried = 0;
+		i = 0;
+		while (remaining > 3 && tried < remaining) {
+			unsigned int a = previous[i], c = next[i];
+			float corner = orientation * triangleArea2(points, a, i, c);
+			int ear = corner >= 0;
+			for (j = next[c]; ear && corner > 0 && nbReflex && j != a; j = next[j]) {
+				/* Un sommet confondu avec un coin du triangle ne l'empêche pas d'être une oreille */
+				if (!reflex[j] || (points[2 * j] == points[2 * a] && points[2 * j + 1] == points[2 * a + 1])
+						|| (points[2 * j] == points[2 * c] && points[2 * j + 1] == points[2 * c + 1])) {
+					continue;
+				}
+				ear = orientation * triangleArea2(points, a, i, j) < 0 || orientation * triangleArea2(points, i, c, j) < 0
+					|| orientation * triangleArea2(points, c, a, j) < 0;
+			}
+			if (!ear) {
+				i = c;
+				tried++;
+				continue;
+			}
+			if (corner > 0) {
+				triangles[written++] = a;
+				triangles[written++] = i;
+				triangles[written++] = c;
+			}
+			next[a] = c;
+			previous[c] = a;
+			nbReflex -= reflex[i];
+			if (reflex[a] && orientation * triangleArea2(points, previous[a], a, c) >= 0) {
+				reflex[a] = 0;
+				nbReflex--;
+			}
+			if (reflex[c] && orientation * triangleArea2(points, a, c, next[c]) >= 0) {
+				reflex[c] = 0;
+				nbReflex--;
+			}
+			remaining--;
+			tried = 0;
+			i = c;
+		}
+		if (remaining == 3) {
+			if (orientation * triangleArea2(points, previous[i], i, next[i]) > 0) {
+				triangles[written++] = previous[i];
+				triangles[written++] = i;
+				triangles[written++] = next[i];
+			}
+			free(links);
+			return written;
+		}
+		free(links);
+	}
+	for (written = 0, i = 1; i + 1 < count; ++i) {
+		triangles[written++] = 0;
+		triangles[written++] = i;
+		triangles[written++] = i + 1;
+	}
+	return written;
+}
+
+/* Tampon de conversion réutilisé d'un envoi à l'autre */
+static Vertex* uploadBuffer = NULL;
+static unsigned int uploadCapacity = 0;
+
+int reserveUploadBuffer(unsigned int count) {
+	if (count > uploadCapacity) {
+		unsigned int capacity = uploadCapacity ? uploadCapacity : 64;
+		while (capacity < count) {
+			capacity *= 2;
+		}
+		Vertex* buffer = (Vertex*) realloc(uploadBuffer, capacity * sizeof(Vertex));
+		if (!buffer) {
+			return 0;
+		}
+		uploadBuffer = buffer;
+		uploadCapacity = capacity;
+	}
+	return 1;
+}
+
+/*
+Triangles d'un GL_POLYGON, gardés dans un tampon d'indices : le polygone est dessiné comme les autres primitives, sans
+que le pilote le redécoupe à chaque image, et les contours concaves sont remplis correctement.
+*/
+void triangulatePrimitive(Primitive* primitive) {
+	unsigned int n = primitiveVertexCount(primitive);
+	unsigned int i;
+	primitive->indexCount = 0;
+	if (primitive->primitiveType != GL_POLYGON || n < 3) {
+		return;
+	}
+	float* points = (float*) malloc(2 * n * sizeof(float));
+	unsigned int* triangles = (unsigned int*) malloc(3 * (n - 2) * sizeof(unsigned int));
+	if (points && triangles) {
+		for (i = 0; i < n; ++i) {
+			primitiveVertex(primitive, i, &points[2 * i], &points[2 * i + 1]);
+		}
+		unsigned int count = triangulatePolygon(points, n, triangles);
+		if (!primitive->indexVbo) {
+			glGenBuffers(1, &primitive->indexVbo);
+		}
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, primitive->indexVbo);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, count * sizeof(unsigned int), triangles, GL_STATIC_DRAW);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+		primitive->indexCount = count;
+	}
+	free(points);
+	free(triangles);
+}
+
+void uploadPrimitive(Primitive* primitive) {
+	assert(primitive);
+	const PointArray* points = &primitive->points;
+	unsigned int i;
+
+	if (primitive->fileVertices) {
+		/* Sommets déjà au format du VBO : envoyés directement depuis le fichier, sans conversion */
+		if (!primitive->vbo) {
+			glGenBuffers(1, &primitive->vbo);
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, primitive->vbo);
+		glBufferData(GL_ARRAY_BUFFER, primitive->fileCount * sizeof(Vertex), primitive->fileVertices, GL_STATIC_DRAW);
+		primitive->vboCount = primitive->fileCount;
+		primitive->points.dirty = 0;
+		primitive->lodLevel = LOD_NONE;
+		triangulatePrimitive(primitive);
+		return;
+	}
+
+	if (!reserveUploadBuffer(points->count)) {
+		return;
+	}
+	/* On entrelace position et couleur pour n'avoir qu'un seul tampon par primitive */
+	for (i = 0; i < points->count; ++i) {
+		uploadBuffer[i].x = points->x[i];
+		uploadBuffer[i].y = points->y[i];
+		uploadBuffer[i].r = points->rgb[3 * i];
+		uploadBuffer[i].g = points->rgb[3 * i + 1];
+		uploadBuffer[i].b = points->rgb[3 * i + 2];
+		uploadBuffer[i].a = 255;
+	}
+
+	if (!primitive->vbo) {
+		glGenBuffers(1, &primitive->vbo);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, primitive->vbo);
+	glBufferData(GL_ARRAY_BUFFER, points->count * sizeof(Vertex), uploadBuffer, GL_STATIC_DRAW);
+	primitive->vboCount = points->count;
+	primitive->points.dirty = 0;
+	primitive->lodLevel = LOD_NONE;
+	triangulatePrimitive(primitive);
+}
+
+/*
+Simplification des lignes denses (GL_LINE_STRIP et GL_LINE_LOOP) pour des pixels de pixelSize unités du plan : un
+sommet n'est gardé que s'il est à au moins une tolérance du dernier sommet gardé, le premier et le dernier l'étant
+toujours. La tolérance est la plus grande puissance de 2 qui ne dépasse pas un pixel : l'écart reste sous le pixel et
+la version simplifiée n'est refaite que quand le zoom change de niveau. Renvoie 0 si la primitive doit être dessinée
+en entier (ligne courte, ou trop peu de sommets retirés pour valoir un second VBO).
+*/
+int simplifyPrimitive(Primitive* primitive, float pixelSize) {
+	GLenum type = primitive->primitiveType;
+	unsigned int n = primitive->vboCount;
+	unsigned int i;
+	if ((type != GL_LINE_STRIP && type != GL_LINE_LOOP) || n < LOD_MIN_POINTS || !(pixelSize > 0 && pixelSize < 1e30f)) {
+		return 0;
+	}
+	int level = (int) floorf(log2f(pixelSize));
+	if (level == primitive->lodLevel) {
+		return primitive->lodCount > 0;
+	}
+	primitive->lodLevel = level;
+	primitive->lodCount = 0;
+
+	if (!reserveUploadBuffer(n)) {
+		return 0;
+	}
+	float tolerance = ldexpf(1.f, level);
+	float lastX = 0, lastY = 0;
+	unsigned int count = 0;
+	for (i = 0; i < n; ++i) {
+		float x, y;
+		primitiveVertex(primitive, i, &x, &y);
+		if (i > 0 && i + 1 < n && fabsf(x - lastX) < tolerance && fabsf(y - lastY) < tolerance) {
+			continue;
+		}
+		const unsigned char* rgb = primitiveColor(primitive, i);
+		uploadBuffer[count].x = x;
+		uploadBuffer[count].y = y;
+		uploadBuffer[count].r = rgb[0];
+		uploadBuffer[count].g = rgb[1];
+		uploadBuffer[count].b = rgb[2];
+		uploadBuffer[count].a = 255;
+		count++;
+		lastX = x;
+		lastY = y;
+	}
+	if (4 * count > 3 * n) {
+		return 0;
+	}
+	if (!primitive->lodVbo) {
+		glGenBuffers(1, &primitive->lodVbo);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, primitive->lodVbo);
+	glBufferData(GL_ARRAY_BUFFER, count * sizeof(Vertex), uploadBuffer, GL_STATIC_DRAW);
+	primitive->lodCount = count;
+	return 1;
+}
+
+#define CURVE_TOLERANCE 0.5f // écart maximal entre la courbe et ses segments, en pixels
+#define CURVE_FINEST_LEVEL -12 // niveau de découpe quand la taille des pixels est inconnue
+#define CURVE_MAX_DEPTH 16 // subdivisions au plus par morceau
+
+/* Morceau k d'une courbe, ramené à une courbe de Bézier cubique ; first et last : points dont on mélange les couleurs */
+unsigned int curvePieceCount(const Primitive* primitive) {
+	unsigned int n = primitiveVertexCount(primitive);
+	switch (primitive->primitiveType) {
+		case PRIMITIVE_QUADRATIC_BEZIER:
+			return n >= 3 ? (n - 1) / 2 : 0;
+		case PRIMITIVE_CUBIC_BEZIER:
+			return n >= 4 ? (n - 1) / 3 : 0;
+		case PRIMITIVE_CATMULL_ROM:
+			return n >= 2 ? n - 1 : 0;
+		default:
+			return 0;
+	}
+}
+
+void curvePiece(const Primitive* primitive, unsigned int k, float x[4], float y[4], unsigned int* first, unsigned int* last) {
+	unsigned int n = primitiveVertexCount(primitive);
+	unsigned int i;
+	float px[4], py[4];
+	switch (primitive->primitiveType) {
+		case PRIMITIVE_QUADRATIC_BEZIER:
+			/* Élévation de degré : les points intérieurs sont aux 2/3 des segments vers le point du milieu */
+			for (i = 0; i < 3; ++i) {
+				primitiveVertex(primitive, 2 * k + i, &px[i], &py[i]);
+			}
+			x[0] = px[0];
+			y[0] = py[0];
+			x[1] = px[0] + 2.f / 3.f * (px[1] - px[0]);
+			y[1] = py[0] + 2.f / 3.f * (py[1] - py[0]);
+			x[2] = px[2] + 2.f / 3.f * (px[1] - px[2]);
+			y[2] = py[2] + 2.f / 3.f * (py[1] - py[2]);
+			x[3] = px[2];
+			y[3] = py[2];
+			*first = 2 * k;
+			*last = 2 * k + 2;
+			break;
+		case PRIMITIVE_CUBIC_BEZIER:
+			for (i = 0; i < 4; ++i) {
+				primitiveVertex(primitive, 3 * k + i, &x[i], &y[i]);
+			}
+			*first = 3 * k;
+			*last = 3 * k + 3;
+			break;
+		default:
+			/* Catmull-Rom entre P(k) et P(k+1), les extrémités étant répétées */
+			primitiveVertex(primitive, k > 0 ? k - 1 : 0, &px[0], &py[0]);
+			primitiveVertex(primitive, k, &px[1], &py[1]);
+			primitiveVertex(primitive, k + 1, &px[2], &py[2]);
+			primitiveVertex(primitive, k + 2 < n ? k + 2 : n - 1, &px[3], &py[3]);
+			x[0] = px[1];
+			y[0] = py[1];
+			x[1] = px[1] + (px[2] - px[0]) / 6.f;
+			y[1] = py[1] + (py[2] - py[0]) / 6.f;
+			x[2] = px[2] - (px[3] - px[1]) / 6.f;
+			y[2] = py[2] - (py[3] - py[1]) / 6.f;
+			x[3] = px[2];
+			y[3] = py[2];
+			*first = k;
+			*last = k + 1;
+			break;
+	}
+}
+
+/* Point de paramètre t d'une courbe de Bézier cubique */
+void cubicPoint(const float x[4], const float y[4], float t, float* px, float* py) {
+	float s = 1 - t;
+	float a = s * s * s, b = 3 * s * s * t, c = 3 * s * t * t, d = t * t * t;
+	*px = a * x[0] + b * x[1] + c * x[2] + d * x[3];
+	*py = a * y[0] + b * y[1] + c * y[2] + d * y[3];
+}
+
+typedef struct CurveTessellation {
+	unsigned int count; // sommets écrits dans uploadBuffer
+	const unsigned char* from; // couleurs des extrémités du morceau en cours
+	const unsigned char* to;
+	float tolerance2; // 16 fois le carré de la tolérance, pour le test de planéité
+} CurveTessellation;
+
+int addCurveVertex(CurveTessellation* tessellation, float x, float y, float t) {
+	if (!reserveUploadBuffer(tessellation->count + 1)) {
+		return 0;
+	}
+	Vertex* vertex = &uploadBuffer[tessellation->count++];
+	vertex->x = x;
+	vertex->y = y;
+	vertex->r = (unsigned char) (tessellation->from[0] + t * (tessellation->to[0] - tessellation->from[0]) + 0.5f);
+	vertex->g = (unsigned char) (tessellation->from[1] + t * (tessellation->to[1] - tessellation->from[1]) + 0.5f);
+	vertex->b = (unsigned char) (tessellation->from[2] + t * (tessellation->to[2] - tessellation->from[2]) + 0.5f);
+	vertex->a = 255;
+	return 1;
+}
+
+/*
+Subdivision adaptative : le morceau est coupé en deux (de Casteljau) tant que ses points de contrôle intérieurs
+s'écartent de plus de la tolérance de leur place sur la corde. Seule l'extrémité t1 est émise, t0 l'a déjà été.
+*/
+int flattenCubic(CurveTessellation* tessellation, const float x[4], const float y[4], float t0, float t1, int depth) {
+	float ux = 3 * x[1] - 2 * x[0] - x[3], uy = 3 * y[1] - 2 * y[0] - y[3];
+	float vx = 3 * x[2] - x[0] - 2 * x[3], vy = 3 * y[2] - y[0] - 2 * y[3];
+	if (depth >= CURVE_MAX_DEPTH || fmaxf(ux * ux, vx * vx) + fmaxf(uy * uy, vy * vy) <= tessellation->tolerance2) {
+		return addCurveVertex(tessellation, x[3], y[3], t1);
+	}
+	float left[2][4], right[2][4];
+	const float* c[2] = {x, y};
+	int axis;
+	for (axis = 0; axis < 2; ++axis) {
+		const float* p = c[axis];
+		float p01 = (p[0] + p[1]) / 2, p12 = (p[1] + p[2]) / 2, p23 = (p[2] + p[3]) / 2;
+		float p012 = (p01 + p12) / 2, p123 = (p12 + p23) / 2;
+		float middle = (p012 + p123) / 2;
+		left[axis][0] = p[0];
+		left[axis][1] = p01;
+		left[axis][2] = p012;
+		left[axis][3] = middle;
+		right[axis][0] = middle;
+		right[axis][1] = p123;
+		right[axis][2] = p23;
+		right[axis][3] = p[3];
+	}
+	float tm = (t0 + t1) / 2;
+	return flattenCubic(tessellation, left[0], left[1], t0, tm, depth + 1)
+		&& flattenCubic(tessellation, right[0], right[1], tm, t1, depth + 1);
+}
+
+/*
+Découpe une courbe en segments pour des pixels de pixelSize unités du plan (0 si inconnue), dans lodVbo. Comme pour
+simplifyPrimitive(), la tolérance suit la plus grande puissance de 2 qui ne dépasse pas un pixel : la découpe est
+gardée tant que le zoom reste au même niveau. Renvoie 0 si la courbe n'a encore aucun morceau complet.
+*/
+int tessellateCurve(Primitive* primitive, float pixelSize) {
+	unsigned int pieces = curvePieceCount(primitive);
+	unsigned int k;
+	float size = pixelSize < 1e30f ? pixelSize : 1e30f;
+	int level = size > 0 ? (int) floorf(log2f(size)) : CURVE_FINEST_LEVEL;
+	if (level < CURVE_FINEST_LEVEL) {
+		level = CURVE_FINEST_LEVEL;
+	}
+	if (level == primitive->lodLevel) {
+		return primitive->lodCount > 0;
+	}
+	primitive->lodLevel = level;
+	primitive->lodCount = 0;
+	if (!pieces) {
+		return 0;
+	}
+
+	float tolerance = CURVE_TOLERANCE * ldexpf(1.f, level);
+	CurveTessellation tessellation = {0, NULL, NULL, 16 * tolerance * tolerance};
+	for (k = 0; k < pieces; ++k) {
+		float x[4], y[4];
+		unsigned int first, last;
+		curvePiece(primitive, k, x, y, &first, &last);
+		tessellation.from = primitiveColor(primitive, first);
+		tessellation.to = primitiveColor(primitive, last);
+		if ((k == 0 && !addCurveVertex(&tessellation, x[0], y[0], 0)) || !flattenCubic(&tessellation, x, y, 0, 1, 0)) {
+			primitive->lodLevel = LOD_NONE;
+			return 0;
+		}
+	}
+	if (!primitive->lodVbo) {
+		glGenBuffers(1, &primitive->lodVbo);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, primitive->lodVbo);
+	glBufferData(GL_ARRAY_BUFFER, tessellation.count * sizeof(Vertex), uploadBuffer, GL_STATIC_DRAW);
+	primitive->lodCount = tessellation.count;
+	return 1;
+}
+
+/*
+À appeler entre glEnableClientState() et glDisableClientState() des tableaux de sommets et de couleurs.
+pixelSize : taille d'un pixel en unités du plan, pour simplifier les lignes denses et découper les courbes ; 0 pour
+tout dessiner en entier et découper les courbes finement.
+*/
+void drawPrimitive(Primitive* primitive, float pixelSize) {
+	GLenum type = primitive->primitiveType;
+	int curve = isCurveType(type);
+	if (primitive->points.dirty) {
+		uploadPrimitive(primitive);
+	}
+	if (primitive->vbo && !primitive->points.dirty) {
+		int simplified = curve ? tessellateCurve(primitive, pixelSize) : simplifyPrimitive(primitive, pixelSize);
+		if (curve && !simplified) {
+			return;
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, simplified ? primitive->lodVbo : primitive->vbo);
+		glVertexPointer(2, GL_FLOAT, sizeof(Vertex), (const GLvoid*) 0);
+		glColorPointer(3, GL_UNSIGNED_BYTE, sizeof(Vertex), (const GLvoid*) (2 * sizeof(float)));
+		if (primitive->indexCount) {
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, primitive->indexVbo);
+			glDrawElements(GL_TRIANGLES, primitive->indexCount, GL_UNSIGNED_INT, (const GLvoid*) 0);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+		} else {
+			glDrawArrays(curve ? GL_LINE_STRIP : type, 0, simplified ? primitive->lodCount : primitive->vboCount);
+		}
+	} else {
+		/* L'envoi a échoué (mémoire insuffisante) : on dessine en mode immédiat, les courbes par leurs points de contrôle */
+		glBegin(curve ? GL_LINE_STRIP : type);
+		drawPoints(&primitive->points);
+		glEnd();
+	}
+}
+
+void drawPrimitives(const PrimitiveList* list) {
+	/*
+	Chaque primitive est envoyée une seule fois au GPU, puis redessinée avec un unique glDrawArrays.
+	Seules les primitives modifiées depuis l'image précédente sont renvoyées.
+	*/
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+	Primitive* primitive;
+	for (primitive = list->head; primitive; primitive = primitive->next) {
+		drawPrimitive(primitive, 0);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glDisableClientState(GL_COLOR_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+}
+
+void deletePrimitiveBuffers(Primitive* primitive) {
+	if (primitive->vbo) {
+		glDeleteBuffers(1, &primitive->vbo);
+		primitive->vbo = 0;
+	}
+	if (primitive->lodVbo) {
+		glDeleteBuffers(1, &primitive->lodVbo);
+		primitive->lodVbo = 0;
+	}
+	if (primitive->indexVbo) {
+		glDeleteBuffers(1, &primitive->indexVbo);
+		primitive->indexVbo = 0;
+	}
+}
+
+/*
+Après un changement de contexte, les noms ne sont plus valides : on les oublie sans les supprimer, et les sommets
+seront renvoyés au prochain dessin.
+*/
+void forgetPrimitiveBuffers(Primitive* primitive) {
+	primitive->vbo = 0;
+	primitive->vboCount = 0;
+	primitive->lodVbo = 0;
+	primitive->lodCount = 0;
+	primitive->lodLevel = LOD_NONE;
+	primitive->indexVbo = 0;
+	primitive->indexCount = 0;
+	primitive->points.dirty = 1;
+}
+
+/* Supprime les VBO des primitives puis rend en une fois toute la mémoire du dessin */
+void deletePrimitive(PrimitiveList* list, Arena* arena) {
+	assert(list);
+	Primitive* primitive;
+	for (primitive = list->head; primitive; primitive = primitive->next) {
+		deletePrimitiveBuffers(primitive);
+	}
+	initPrimitiveList(list);
+	clearArena(arena);
+}
+
+/*
+Index spatial : grille uniforme de cellules carrées, chaque primitive est rangée dans les cellules que couvre sa boîte
+englobante. Les cellules sont réparties dans une table de hachage de taille fixe : la grille n'a pas de bornes et sa
+mémoire ne dépend que du nombre de primitives. Une primitive qui couvrirait plus de GRID_MAX_CELLS cellules est gardée
+à part et testée à chaque requête.
+La grille suit la liste en n'indexant que ce qui a été ajouté depuis la requête précédente : nouvelles primitives et
+points ajoutés à la dernière. Toute autre modification (effacement, annulation, chargement) doit être signalée par
+invalidateSpatialGrid() : la grille est alors reconstruite à la requête suivante.
+*/
+#define GRID_MAX_CELLS 64
+#define GRID_MAX_COORDINATE (1 << 28) // borne des indices de cellule, pour les coordonnées démesurées
+
+/* Double la capacité d'un tableau. Renvoie le nouveau tableau, ou NULL (l'ancien reste valide) si la mémoire manque. */
+void* growArray(void* data, unsigned int* capacity, size_t elementSize) {
+	unsigned int newCapacity = *capacity ? 2 * *capacity : 64;
+	void* grown = realloc(data, newCapacity * elementSize);
+	if (grown) {
+		*capacity = newCapacity;
+	}
+	return grown;
+}
+
+void initSpatialGrid(SpatialGrid* grid, float cellSize) {
+	assert(grid);
+	assert(cellSize > 0);
+	memset(grid, 0, sizeof(SpatialGrid));
+	grid->cellSize = cellSize;
+	grid->stale = 1;
+}
+
+void deleteSpatialGrid(SpatialGrid* grid) {
+	assert(grid);
+	free(grid->entries);
+	free(grid->large);
+	free(grid->found);
+	initSpatialGrid(grid, grid->cellSize);
+}
+
+void invalidateSpatialGrid(SpatialGrid* grid) {
+	assert(grid);
+	grid->stale = 1;
+}
+
+int cellCoordinate(const SpatialGrid* grid, float value) {
+	float cell = floorf(value / grid->cellSize);
+	if (cell < -GRID_MAX_COORDINATE) {
+		return -GRID_MAX_COORDINATE;
+	}
+	if (cell > GRID_MAX_COORDINATE) {
+		return GRID_MAX_COORDINATE;
+	}
+	return (int) cell;
+}
+
+/* Cellules couvertes par une boîte : range = {x0, y0, x1, y1}. Renvoie leur nombre, 0 pour une boîte vide. */
+double cellRange(const SpatialGrid* grid, const Box* box, int range[4]) {
+	if (box->minX > box->maxX || box->minY > box->maxY) {
+		return 0;
+	}
+	range[0] = cellCoordinate(grid, box->minX);
+	range[1] = cellCoordinate(grid, box->minY);
+	range[2] = cellCoordinate(grid, box->maxX);
+	range[3] = cellCoordinate(grid, box->maxY);
+	return (double) (range[2] - range[0] + 1) * (range[3] - range[1] + 1);
+}
+
+unsigned int cellBucket(int cellX, int cellY) {
+	return ((unsigned int) cellX * 73856093u ^ (unsigned int) cellY * 19349663u) & (GRID_BUCKETS - 1);
+}
+
+/* Range une primitive dans les cellules de sa boîte, sauf celles de la boîte old où elle l'est déjà (NULL sinon) */
+int indexPrimitive(SpatialGrid* grid, Primitive* primitive, const Box* old) {
+	int range[4], oldRange[4];
+	int x, y;
+	double cells = cellRange(grid, &primitive->bounds, range);
+	double oldCells = old ? cellRange(grid, old, oldRange) : 0;
+
+	if (oldCells > GRID_MAX_CELLS) {
+		return 1; // déjà parmi les grandes primitives
+	}
+	if (cells > GRID_MAX_CELLS) {
+		if (grid->nbLarge == grid->largeCapacity) {
+			Primitive** large = (Primitive**) growArray(grid->large, &grid->largeCapacity, sizeof(Primitive*));
+			if (!large) {
+				return 0;
+			}
+			grid->large = large;
+		}
+		grid->large[grid->nbLarge++] = primitive;
+		return 1;
+	}
+	for (y = range[1]; cells > 0 && y <= range[3]; ++y) {
+		for (x = range[0]; x <= range[2]; ++x) {
+			if (oldCells > 0 && x >= oldRange[0] && x <= oldRange[2] && y >= oldRange[1] && y <= oldRange[3]) {
+				continue;
+			}
+			if (grid->nbEntries == grid->entriesCapacity) {
+				GridEntry* entries = (GridEntry*) growArray(grid->entries, &grid->entriesCapacity, sizeof(GridEntry));
+				if (!entries) {
+					return 0;
+				}
+				grid->entries = entries;
+			}
+			unsigned int bucket = cellBucket(x, y);
+			GridEntry* entry = &grid->entries[grid->nbEntries];
+			entry->primitive = primitive;
+			entry->cellX = x;
+			entry->cellY = y;
+			entry->next = grid->buckets[bucket];
+			grid->buckets[bucket] = grid->nbEntries++;
+		}
+	}
+	return 1;
+}
+
+/* Met la grille à jour avec ce qui a été ajouté à la liste depuis l'appel précédent */
+void syncSpatialGrid(SpatialGrid* grid, const PrimitiveList* list) {
+	assert(grid);
+	assert(list);
+	if (grid->stale || list->count < grid->count) {
+		memset(grid->buckets, -1, sizeof(grid->buckets));
+		grid->nbEntries = 0;
+		grid->nbLarge = 0;
+		grid->last = NULL;
+		grid->count = 0;
+		grid->stale = 0;
+	}
+	if (grid->last && memcmp(&grid->last->bounds, &grid->lastBounds, sizeof(Box))) {
+		/* Seule la dernière primitive indexée a pu grandir : les suivantes n'étaient pas encore dans la grille */
+		indexPrimitive(grid, grid->last, &grid->lastBounds);
+		grid->lastBounds = grid->last->bounds;
+	}
+	Primitive* primitive = grid->last ? grid->last->next : list->head;
+	for (; primitive && grid->count < list->count; primitive = primitive->next) {
+		indexPrimitive(grid, primitive, NULL);
+		grid->last = primitive;
+		grid->lastBounds = primitive->bounds;
+		grid->count++;
+	}
+}
+
+int addFoundPrimitive(SpatialGrid* grid, Primitive* primitive) {
+	if (grid->nbFound == grid->foundCapacity) {
+		Primitive** found = (Primitive**) growArray(grid->found, &grid->foundCapacity, sizeof(Primitive*));
+		if (!found) {
+			return 0;
+		}
+		grid->found = found;
+	}
+	grid->found[grid->nbFound++] = primitive;
+	return 1;
+}
+
+int comparePrimitiveIndex(const void* a, const void* b) {
+	unsigned int indexA = (*(Primitive* const*) a)->index;
+	unsigned int indexB = (*(Primitive* const*) b)->index;
+	return (indexA > indexB) - (indexA < indexB);
+}
+
+/* Cherche les primitives dont la boîte rencontre box : grid->found, dans l'ordre de la liste et sans doublon */
+void querySpatialGrid(SpatialGrid* grid, const Box* box) {
+	assert(grid);
+	assert(box);
+	int range[4];
+	int x, y, i;
+	unsigned int j, k;
+	double cells = cellRange(grid, box, range);
+
+	grid->nbFound = 0;
+	if (cells > grid->nbEntries) {
+		/* Zone plus vaste que ce qui est rangé : on parcourt les entrées plutôt que les cellules */
+		for (j = 0; j < grid->nbEntries; ++j) {
+			if (boxesIntersect(&grid->entries[j].primitive->bounds, box)) {
+				addFoundPrimitive(grid, grid->entries[j].primitive);
+			}
+		}
+	} else {
+		for (y = range[1]; cells > 0 && y <= range[3]; ++y) {
+			for (x = range[0]; x <= range[2]; ++x) {
+				for (i = grid->buckets[cellBucket(x, y)]; i >= 0; i = grid->entries[i].next) {
+					const GridEntry* entry = &grid->entries[i];
+					if (entry->cellX == x && entry->cellY == y && boxesIntersect(&entry->primitive->bounds, box)) {
+						addFoundPrimitive(grid, entry->primitive);
+					}
+				}
+			}
+		}
+	}
+	for (j = 0; j < grid->nbLarge; ++j) {
+		if (boxesIntersect(&grid->large[j]->bounds, box)) {
+			addFoundPrimitive(grid, grid->large[j]);
+		}
+	}
+
+	/* Une primitive rangée dans plusieurs cellules est trouvée plusieurs fois */
+	if (grid->nbFound > 1) {
+		qsort(grid->found, grid->nbFound, sizeof(Primitive*), comparePrimitiveIndex);
+	}
+	for (j = k = 0; j < grid->nbFound; ++j) {
+		if (k == 0 || grid->found[k - 1] != grid->found[j]) {
+			grid->found[k++] = grid->found[j];
+		}
+	}
+	grid->nbFound = k;
+}
+
+/*
+Passage du plan à l'écran d'après les matrices courantes, pour les transformations affines du plan :
+écran = (m[0] x + m[2] y + m[4], m[1] x + m[3] y + m[5]), en coordonnées normalisées [-1, 1].
+Renvoie 0 si la transformation n'est pas inversible.
+*/
+int viewTransform(float m[6]) {
+	GLfloat projection[16], modelview[16];
+	int i;
+	glGetFloatv(GL_PROJECTION_MATRIX, projection);
+	glGetFloatv(GL_MODELVIEW_MATRIX, modelview);
+	/* Colonnes x, y et translation du produit projection * modelview, lignes x et y */
+	const int columns[3] = {0, 1, 3};
+	for (i = 0; i < 3; ++i) {
+		const GLfloat* column = modelview + 4 * columns[i];
+		m[2 * i] = projection[0] * column[0] + projection[4] * column[1] + projection[8] * column[2] + projection[12] * column[3];
+		m[2 * i + 1] = projection[1] * column[0] + projection[5] * column[1] + projection[9] * column[2] + projection[13] * column[3];
+	}
+	return fabsf(m[0] * m[3] - m[2] * m[1]) > 1e-12f;
+}
+
+/* Point du plan affiché aux coordonnées normalisées (ndcX, ndcY) */
+void unprojectPoint(const float m[6], float ndcX, float ndcY, float* x, float* y) {
+	float det = m[0] * m[3] - m[2] * m[1];
+	float dx = ndcX - m[4];
+	float dy = ndcY - m[5];
+	*x = (m[3] * dx - m[2] * dy) / det;
+	*y = (m[0] * dy - m[1] * dx) / det;
+}
+
+/* Zone du plan visible à l'écran ; tout le plan si les matrices ne permettent pas de la calculer */
+Box visibleBox() {
+	Box box = emptyBox();
+	float m[6];
+	float x, y;
+	int i;
+	if (!viewTransform(m)) {
+		box.minX = box.minY = -FLT_MAX;
+		box.maxX = box.maxY = FLT_MAX;
+		return box;
+	}
+	for (i = 0; i < 4; ++i) {
+		unprojectPoint(m, i & 1 ? 1.f : -1.f, i & 2 ? 1.f : -1.f, &x, &y);
+		extendBox(&box, x, y);
+	}
+	return box;
+}
+
+/* Point du plan sous le pixel (px, py) de la fenêtre (origine en haut à gauche, comme les évènements SDL) */
+int windowToPlane(float px, float py, float* x, float* y) {
+	GLint viewport[4];
+	float m[6];
+	if (!viewTransform(m)) {
+		return 0;
+	}
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	unprojectPoint(m, 2.f * (px - viewport[0]) / viewport[2] - 1.f, 1.f - 2.f * (py - viewport[1]) / viewport[3], x, y);
+	return 1;
+}
+
+/* Longueur dans le plan de pixels pixels de la fenêtre (la plus grande des deux directions), 0 si la vue ne s'inverse pas */
+float windowLengthToPlane(float pixels) {
+	float x0, y0, x1, y1, x2, y2;
+	if (!windowToPlane(0, 0, &x0, &y0) || !windowToPlane(pixels, 0, &x1, &y1) || !windowToPlane(0, pixels, &x2, &y2)) {
+		return 0;
+	}
+	float horizontal = sqrtf((x1 - x0) * (x1 - x0) + (y1 - y0) * (y1 - y0));
+	float vertical = sqrtf((x2 - x0) * (x2 - x0) + (y2 - y0) * (y2 - y0));
+	return horizontal > vertical ? horizontal : vertical;
+}
+
+/*
+Comme drawPrimitives(), mais seules les primitives qui rencontrent la zone visible sont dessinées, et les lignes denses
+sont simplifiées à la taille des pixels : le nombre de sommets suit ce qui est à l'écran plutôt que ce qui est stocké.
+*/
+void drawVisiblePrimitives(const PrimitiveList* list, SpatialGrid* grid) {
+	unsigned int i;
+	GLint viewport[4];
+	Box view = visibleBox();
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	float pixelSize = viewport[2] > 0 ? (view.maxX - view.minX) / viewport[2] : 0;
+	syncSpatialGrid(grid, list);
+	querySpatialGrid(grid, &view);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+	for (i = 0; i < grid->nbFound; ++i) {
+		drawPrimitive(grid->found[i], pixelSize);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glDisableClientState(GL_COLOR_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+}
+
+#define PICK_CURVE_STEPS 32 // segments par morceau de courbe pour la sélection
+
+/* Carré de la distance du point p au segment [a, b] */
+float segmentDistance2(float px, float py, float ax, float ay, float bx, float by) {
+	float dx = bx - ax;
+	float dy = by - ay;
+	float length2 = dx * dx + dy * dy;
+	float t = length2 > 0 ? ((px - ax) * dx + (py - ay) * dy) / length2 : 0;
+	t = t < 0 ? 0 : t > 1 ? 1 : t;
+	float ex = ax + t * dx - px;
+	float ey = ay + t * dy - py;
+	return ex * ex + ey * ey;
+}
+
+/* Points, lignes et courbes : distance aux sommets et aux segments ; surfaces : boîte englobante */
+int primitiveNear(const Primitive* primitive, float x, float y, float tolerance) {
+	unsigned int n = primitiveVertexCount(primitive);
+	unsigned int i;
+	float ax, ay, bx, by;
+	GLenum type = primitive->primitiveType;
+	if (isCurveType(type)) {
+		/* Courbe découpée à pas fixe : l'écart reste petit devant la tolérance de sélection */
+		unsigned int pieces = curvePieceCount(primitive);
+		unsigned int k, first, last;
+		for (k = 0; k < pieces; ++k) {
+			float cx[4], cy[4];
+			curvePiece(primitive, k, cx, cy, &first, &last);
+			ax = cx[0];
+			ay = cy[0];
+			for (i = 1; i <= PICK_CURVE_STEPS; ++i) {
+				cubicPoint(cx, cy, (float) i / PICK_CURVE_STEPS, &bx, &by);
+				if (segmentDistance2(x, y, ax, ay, bx, by) <= tolerance * tolerance) {
+					return 1;
+				}
+				ax = bx;
+				ay = by;
+			}
+		}
+		return 0;
+	}
+	if (type == GL_POINTS) {
+		for (i = 0; i < n; ++i) {
+			primitiveVertex(primitive, i, &ax, &ay);
+			if ((ax - x) * (ax - x) + (ay - y) * (ay - y) <= tolerance * tolerance) {
+				return 1;
+			}
+		}
+		return 0;
+	}
+	if (type == GL_LINES || type == GL_LINE_STRIP || type == GL_LINE_LOOP) {
+		unsigned int step = type == GL_LINES ? 2 : 1;
+		for (i = 0; i + 1 < n; i += step) {
+			primitiveVertex(primitive, i, &ax, &ay);
+			primitiveVertex(primitive, i + 1, &bx, &by);
+			if (segmentDistance2(x, y, ax, ay, bx, by) <= tolerance * tolerance) {
+				return 1;
+			}
+		}
+		if (type == GL_LINE_LOOP && n > 2) {
+			primitiveVertex(primitive, n - 1, &ax, &ay);
+			primitiveVertex(primitive, 0, &bx, &by);
+			return segmentDistance2(x, y, ax, ay, bx, by) <= tolerance * tolerance;
+		}
+		return 0;
+	}
+	return n > 0 && x >= primitive->bounds.minX - tolerance && x <= primitive->bounds.maxX + tolerance
+		&& y >= primitive->bounds.minY - tolerance && y <= primitive->bounds.maxY + tolerance;
+}
+
+/* Primitive dessinée par-dessus les autres au point (x, y) du plan, à tolerance près, ou NULL */
+Primitive* pickPrimitive(const PrimitiveList* list, SpatialGrid* grid, float x, float y, float tolerance) {
+	Box box = {x - tolerance, y - tolerance, x + tolerance, y + tolerance};
+	unsigned int i;
+	syncSpatialGrid(grid, list);
+	querySpatialGrid(grid, &box);
+	for (i = grid->nbFound; i > 0; --i) {
+		if (primitiveNear(grid->found[i - 1], x, y, tolerance)) {
+			return grid->found[i - 1];
+		}
+	}
+	return NULL;
+}
+
+/*
+Caméra 2D : un centre et un zoom, appliqués par la matrice de projection. La matrice modelview reste à l'identité
+pour le dessin et n'accumule plus les déplacements de la vue d'une image à l'autre.
+*/
+#define CAMERA_MIN_ZOOM 0.001f
+#define CAMERA_MAX_ZOOM 10000.f
+#define CAMERA_PAN_STEP 0.05f // fraction de la vue parcourue par appui sur une flèche
+#define CAMERA_ZOOM_STEP 1.25f
+
+/* Remplace la projection par la vue de la caméra et remet la modelview à l'identité */
+void applyCamera(const Camera* camera) {
+	assert(camera);
+	float halfWidth = camera->halfWidth / camera->zoom;
+	float halfHeight = camera->halfHeight / camera->zoom;
+	glMatrixMode(GL_PROJECTION);
+	glLoadIdentity();
+	gluOrtho2D(camera->centerX - halfWidth, camera->centerX + halfWidth,
+		camera->centerY - halfHeight, camera->centerY + halfHeight);
+	glMatrixMode(GL_MODELVIEW);
+	glLoadIdentity();
+}
+
+/* Déplace la vue de (dx, dy) fois sa largeur et sa hauteur */
+void panCamera(Camera* camera, float dx, float dy) {
+	assert(camera);
+	camera->centerX += 2 * dx * camera->halfWidth / camera->zoom;
+	camera->centerY += 2 * dy * camera->halfHeight / camera->zoom;
+}
+
+/* Multiplie le zoom par factor en gardant le point (x, y) du plan à la même place à l'écran */
+void zoomCamera(Camera* camera, float factor, float x, float y) {
+	assert(camera);
+	assert(factor > 0);
+	float zoom = camera->zoom * factor;
+	if (zoom < CAMERA_MIN_ZOOM) {
+		zoom = CAMERA_MIN_ZOOM;
+	} else if (zoom > CAMERA_MAX_ZOOM) {
+		zoom = CAMERA_MAX_ZOOM;
+	}
+	factor = zoom / camera->zoom;
+	camera->centerX = x + (camera->centerX - x) / factor;
+	camera->centerY = y + (camera->centerY - y) / factor;
+	camera->zoom = zoom;
+}
+
+/*
+Touches de la caméra : flèches pour se déplacer (le dessin suit la flèche), + et - pour zoomer sur le centre de la vue,
+origine pour revenir à la vue par défaut. Renvoie 1 si la touche a été traitée.
+*/
+int handleCameraKey(Camera* camera, SDLKey key) {
+	assert(camera);
+	switch (key) {
+		case SDLK_UP:
+			panCamera(camera, 0, -CAMERA_PAN_STEP);
+			return 1;
+		case SDLK_DOWN:
+			panCamera(camera, 0, CAMERA_PAN_STEP);
+			return 1;
+		case SDLK_LEFT:
+			panCamera(camera, CAMERA_PAN_STEP, 0);
+			return 1;
+		case SDLK_RIGHT:
+			panCamera(camera, -CAMERA_PAN_STEP, 0);
+			return 1;
+		case SDLK_PLUS:
+		case SDLK_KP_PLUS:
+		case SDLK_EQUALS: // + sans Maj sur les claviers QWERTY
+			zoomCamera(camera, CAMERA_ZOOM_STEP, camera->centerX, camera->centerY);
+			return 1;
+		case SDLK_MINUS:
+		case SDLK_KP_MINUS:
+			zoomCamera(camera, 1 / CAMERA_ZOOM_STEP, camera->centerX, camera->centerY);
+			return 1;
+		case SDLK_HOME:
+			camera->centerX = camera->centerY = 0;
+			camera->zoom = 1;
+			return 1;
+		default:
+			return 0;
+	}
+}
+
+/* Molette : zoom autour du point sous la souris. Renvoie 1 si le bouton est celui de la molette. */
+int handleCameraWheel(Camera* camera, const SDL_MouseButtonEvent* button) {
+	assert(camera);
+	float x, y;
+	if (button->button != SDL_BUTTON_WHEELUP && button->button != SDL_BUTTON_WHEELDOWN) {
+		return 0;
+	}
+	if (windowToPlane(button->x, button->y, &x, &y)) {
+		zoomCamera(camera, button->button == SDL_BUTTON_WHEELUP ? CAMERA_ZOOM_STEP : 1 / CAMERA_ZOOM_STEP, x, y);
+	}
+	return 1;
+}
+
+/*
+Contexte OpenGL : selon la plateforme, SDL_SetVideoMode() en crée un nouveau et tous les noms alloués (tampons,
+programmes) sont perdus. contextGeneration change à chaque nouveau contexte : chaque ressource garde la génération où
+ses noms ont été créés, et les recrée si elle a changé.
+*/
+unsigned int contextGeneration = 0;
+static GLuint contextSentinel = 0; // tampon témoin, alloué dans le contexte courant
+
+/*
+À appeler juste après SDL_SetVideoMode(), avant de créer quoi que ce soit : un nouveau contexte n'a encore alloué aucun
+nom, le témoin ne peut donc pas y désigner un autre tampon (ce qui arrive à un nom vérifié plus tard).
+Renvoie 1 si le contexte a changé.
+*/
+int checkContext() {
+	if (contextSentinel && glIsBuffer(contextSentinel)) {
+		return 0;
+	}
+	int changed = contextSentinel != 0;
+	if (changed) {
+		contextGeneration++;
+	}
+	glGenBuffers(1, &contextSentinel);
+	glBindBuffer(GL_ARRAY_BUFFER, contextSentinel); // un nom n'est un tampon qu'une fois lié
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	return changed;
+}
+
+/* Repère (graduations et axes) précalculé dans un VBO : un seul glDrawArrays() par image */
+static GLuint landmarksVbo = 0;
+static unsigned int landmarksCount = 0;
+static unsigned int landmarksGeneration = 0; // génération du contexte de landmarksVbo
+
+Vertex makeVertex(float x, float y, unsigned char r, unsigned char g, unsigned char b) {
+	Vertex v;
+	v.x = x;
+	v.y = y;
+	v.r = r;
+	v.g = g;
+	v.b = b;
+	v.a = 255;
+	return v;
+}
+
+/* Les graduations sont placées aux multiples entiers de spacing : aucune dérive due à un compteur flottant */
+void buildLandmarks(float xmin, float xmax, float ymin, float ymax, float spacing, float tickSize) {
+	int i;
+	int firstX = (int) ceil(xmin / spacing - 1e-4);
+	int lastX = (int) floor(xmax / spacing + 1e-4);
+	int firstY = (int) ceil(ymin / spacing - 1e-4);
+	int lastY = (int) floor(ymax / spacing + 1e-4);
+	unsigned int count = 2 * (lastX - firstX + 1) + 2 * (lastY - firstY + 1) + 4;
+
+	Vertex* vertices = (Vertex*) malloc(count * sizeof(Vertex));
+	if (!vertices) {
+		return;
+	}
+	Vertex* v = vertices;
+	for(i=firstX; i<=lastX; i++){
+		*v++ = makeVertex(i * spacing, -tickSize, 255, 255, 255);
+		*v++ = makeVertex(i * spacing, tickSize, 255, 255, 255);
+	}
+	for(i=firstY; i<=lastY; i++){
+		*v++ = makeVertex(-tickSize, i * spacing, 255, 255, 255);
+		*v++ = makeVertex(tickSize, i * spacing, 255, 255, 255);
+	}
+	*v++ = makeVertex(xmin, 0, 255, 0, 0);
+	*v++ = makeVertex(xmax, 0, 255, 0, 0);
+	*v++ = makeVertex(0, ymin, 0, 255, 0);
+	*v++ = makeVertex(0, ymax, 0, 255, 0);
+
+	if (landmarksGeneration != contextGeneration) {
+		landmarksVbo = 0; // nom d'un ancien contexte : il n'y a rien à supprimer
+		landmarksGeneration = contextGeneration;
+	}
+	if (!landmarksVbo) {
+		glGenBuffers(1, &landmarksVbo);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, landmarksVbo);
+	glBufferData(GL_ARRAY_BUFFER, count * sizeof(Vertex), vertices, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	landmarksCount = count;
+	free(vertices);
+}
+
+void drawLandmarks(){
+	glBindBuffer(GL_ARRAY_BUFFER, landmarksVbo);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+	glVertexPointer(2, GL_FLOAT, sizeof(Vertex), (const GLvoid*) 0);
+	glColorPointer(3, GL_UNSIGNED_BYTE, sizeof(Vertex), (const GLvoid*) (2 * sizeof(float)));
+	glDrawArrays(GL_LINES, 0, landmarksCount);
+	glDisableClientState(GL_COLOR_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void deleteLandmarks() {
+	if (landmarksVbo && landmarksGeneration == contextGeneration) {
+		glDeleteBuffers(1, &landmarksVbo);
+	}
+	landmarksVbo = 0;
+	landmarksCount = 0;
+}
+
+/*
+Cadence des images : les échéances sont calculées sur une horloge monotone en nanosecondes et s'accumulent d'une image
+à l'autre (échéance précédente + période), si bien que l'erreur d'une attente est rattrapée à l'image suivante.
+On dort jusqu'à un peu avant l'échéance puis on attend activement la fin, plus fine que la granularité du sommeil.
+*/
+#define FRAME_SPIN_NANOSECONDS 500000LL // dernière demi-milliseconde en attente active
+
+/* Horloge monotone en nanosecondes (SDL_GetTicks() ne donne que des millisecondes) */
+long long getTimeNanoseconds() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (long long) now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+/* Budget d'une image en millisecondes, 60 images par seconde quand la cadence est libre ou imposée par l'écran */
+double frameBudgetMilliseconds() {
+	return 1000. / (FRAMERATE && !vsync ? FRAMERATE : 60);
+}
+
+void initFrameScheduler(FrameScheduler* scheduler) {
+	assert(scheduler);
+	/* Avec la synchronisation verticale, c'est l'échange des buffers qui attend l'écran */
+	scheduler->period = FRAMERATE && !vsync ? 1000000000LL / FRAMERATE : 0;
+	scheduler->deadline = getTimeNanoseconds();
+}
+
+/* Attend l'échéance de l'image suivante */
+void waitNextFrame(FrameScheduler* scheduler) {
+	assert(scheduler);
+	if (!scheduler->period) {
+		return;
+	}
+	long long now = getTimeNanoseconds();
+	scheduler->deadline += scheduler->period;
+	if (now > scheduler->deadline + scheduler->period) {
+		/* Plus d'une image de retard (ou reprise après une attente d'évènement) : on repart de maintenant
+		   plutôt que d'enchaîner des images sans pause pour rattraper */
+		scheduler->deadline = now;
+		return;
+	}
+	if (scheduler->deadline - now > FRAME_SPIN_NANOSECONDS) {
+		long long wakeUp = scheduler->deadline - FRAME_SPIN_NANOSECONDS;
+		struct timespec until;
+		until.tv_sec = wakeUp / 1000000000LL;
+		until.tv_nsec = wakeUp % 1000000000LL;
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, NULL) == EINTR) {
+		}
+	}
+	while (getTimeNanoseconds() < scheduler->deadline) {
+	}
+}
+
+/*
+Profilage : durée de chaque étape des images redessinées, gardée pour les PROFILE_WINDOW dernières images (tampon
+circulaire) afin d'en tirer les percentiles et la courbe affichée en surimpression (touche f).
+Les appels OpenGL sont asynchrones : le temps d'une étape de dessin est celui de la soumission des commandes, l'attente
+du GPU apparaît dans l'échange des buffers.
+*/
+#define PROFILE_GRAPH_FRAMES 120 // nombre d'images affichées dans la courbe
+#define PROFILE_PIXELS_PER_MS 4. // échelle verticale de la courbe
+
+FrameProfiler profiler;
+const char* profileFile = NULL;
+
+/* Déclare les étapes du programme : leur nom (colonnes du CSV) et leur couleur dans la courbe */
+void initProfiler(const char* const* stageNames, const unsigned char* stageColors, unsigned int nbStages) {
+	assert(stageNames);
+	assert(stageColors);
+	assert(nbStages <= PROFILE_MAX_STAGES);
+	memset(&profiler, 0, sizeof(profiler));
+	profiler.stageNames = stageNames;
+	profiler.stageColors = stageColors;
+	profiler.nbStages = nbStages;
+}
+
+void beginProfileFrame() {
+	memset(profiler.current, 0, sizeof(profiler.current));
+	profiler.stageStart = getTimeNanoseconds();
+}
+
+/* Attribue à l'étape le temps écoulé depuis la fin de l'étape précédente */
+void endProfileStage(unsigned int stage) {
+	long long now = getTimeNanoseconds();
+	profiler.current[stage] += (now - profiler.stageStart) / 1e6;
+	profiler.stageStart = now;
+}
+
+void endProfileFrame() {
+	memcpy(profiler.samples[profiler.count % PROFILE_WINDOW], profiler.current, sizeof(profiler.current));
+	profiler.count++;
+}
+
+unsigned int profiledFrames() {
+	return profiler.count < PROFILE_WINDOW ? profiler.count : PROFILE_WINDOW;
+}
+
+/* Durée d'une étape pour la i-ème image de la fenêtre (0 = la plus ancienne), nbStages pour l'image entière */
+double profileSample(unsigned int i, unsigned int stage) {
+	const double* sample = profiler.samples[(profiler.count - profiledFrames() + i) % PROFILE_WINDOW];
+	if (stage < profiler.nbStages) {
+		return sample[stage];
+	}
+	double total = 0;
+	for (stage = 0; stage < profiler.nbStages; ++stage) {
+		total += sample[stage];
+	}
+	return total;
+}
+
+int compareDoubles(const void* a, const void* b) {
+	double x = *(const double*) a;
+	double y = *(const double*) b;
+	return (x > y) - (x < y);
+}
+
+/* Calcule les percentiles 50, 95 et 99 d'une étape sur la fenêtre */
+void profilePercentiles(unsigned int stage, double percentiles[3]) {
+	static double sorted[PROFILE_WINDOW];
+	static const double RANKS[3] = {0.50, 0.95, 0.99};
+	unsigned int i, n = profiledFrames();
+	if (n == 0) {
+		percentiles[0] = percentiles[1] = percentiles[2] = 0;
+		return;
+	}
+	for (i = 0; i < n; ++i) {
+		sorted[i] = profileSample(i, stage);
+	}
+	qsort(sorted, n, sizeof(double), compareDoubles);
+	for (i = 0; i < 3; ++i) {
+		percentiles[i] = sorted[(unsigned int) (RANKS[i] * (n - 1) + 0.5)];
+	}
+}
+
+void printProfileSummary(FILE* out) {
+	unsigned int stage;
+	double percentiles[3];
+	fprintf(out, "%-12s %8s %8s %8s  (ms, %u images)\n", "étape", "p50", "p95", "p99", profiledFrames());
+	for (stage = 0; stage <= profiler.nbStages; ++stage) {
+		profilePercentiles(stage, percentiles);
+		fprintf(out, "%-12s %8.3f %8.3f %8.3f\n", stage < profiler.nbStages ? profiler.stageNames[stage] : "total",
+			percentiles[0], percentiles[1], percentiles[2]);
+	}
+}
+
+/* Une ligne par image de la fenêtre : numéro de l'image puis durée de chaque étape en millisecondes */
+int writeProfileCSV(const char* filename) {
+	unsigned int i, stage, n = profiledFrames();
+	FILE* file = fopen(filename, "w");
+	if (!file) {
+		return 0;
+	}
+	fprintf(file, "frame");
+	for (stage = 0; stage < profiler.nbStages; ++stage) {
+		fprintf(file, ",%s", profiler.stageNames[stage]);
+	}
+	fprintf(file, ",total\n");
+	for (i = 0; i < n; ++i) {
+		fprintf(file, "%u", profiler.count - n + i);
+		for (stage = 0; stage <= profiler.nbStages; ++stage) {
+			fprintf(file, ",%.4f", profileSample(i, stage));
+		}
+		fprintf(file, "\n");
+	}
+	fclose(file);
+	return 1;
+}
+
+/* Courbe des dernières images en bas à gauche : une barre par image, empilant les étapes, et le budget en blanc */
+void drawProfileOverlay() {
+	unsigned int i, stage, n = profiledFrames();
+	unsigned int first = n > PROFILE_GRAPH_FRAMES ? n - PROFILE_GRAPH_FRAMES : 0;
+
+	glMatrixMode(GL_PROJECTION);
+	glPushMatrix();
+	glLoadIdentity();
+	gluOrtho2D(0, WINDOW_WIDTH, 0, WINDOW_HEIGHT);
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	glLoadIdentity();
+
+	glBegin(GL_LINES);
+	for (i = first; i < n; ++i) {
+		float x = 10 + 2 * (i - first);
+		float y = 10;
+		for (stage = 0; stage < profiler.nbStages; ++stage) {
+			float height = profileSample(i, stage) * PROFILE_PIXELS_PER_MS;
+			glColor3ubv(profiler.stageColors + 3 * stage);
+			glVertex2f(x, y);
+			glVertex2f(x, y + height);
+			y += height;
+		}
+	}
+	glColor3ub(255, 255, 255);
+	glVertex2f(10, 10 + frameBudgetMilliseconds() * PROFILE_PIXELS_PER_MS);
+	glVertex2f(10 + 2 * PROFILE_GRAPH_FRAMES, 10 + frameBudgetMilliseconds() * PROFILE_PIXELS_PER_MS);
+	glEnd();
+
+	glPopMatrix();
+	glMatrixMode(GL_PROJECTION);
+	glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);
+}
+
+/*
+Banc d'essai (--bench) : scènes synthétiques reproductibles (générateur pseudo-aléatoire à graine fixe), construites et
+dessinées hors de la boucle d'affichage. Chaque image se termine par glFinish() pour que le travail du GPU soit compté.
+Les résultats sont écrits en CSV sur la sortie standard, une ligne par scène.
+*/
+#define BENCH_POINTS 200000 // nombre total de points par type de primitive
+#define BENCH_PRIMITIVES 100 // nombre de primitives entre lesquelles ces points sont répartis
+#define BENCH_SPREAD 0.05f // rayon d'une primitive autour de son centre, pour garder des triangles petits
+#define BENCH_FRAMES 20 // nombre d'images dessinées par mesure
+#define BENCH_CULLED_PRIMITIVES 20000 // primitives du grand dessin, dont on ne voit qu'une petite partie
+#define BENCH_CULLED_EXTENT 20.f // le grand dessin couvre [-20, 20] x [-20, 20], l'écran [-1, 1] x [-1, 1]
+#define BENCH_CELL_SIZE 0.25f
+#define BENCH_STROKES 100 // traits de la scène de simplification
+#define BENCH_STROKE_STEP 0.0002f // pas maximal entre deux points d'un trait, bien plus petit qu'un pixel
+#define BENCH_CIRCLES 2000 // cercles de la scène des courbes
+#define BENCH_CIRCLE_SEGMENTS 100 // découpe fixe des cercles, comme drawCircle() avant les courbes
+#define BENCH_LANDMARK_SPACING 0.0005f // graduations du repère dense
+
+int benchmark = 0;
+unsigned int benchSeed = 1;
+static const char* benchProgram = ""; // première colonne du CSV
+
+/* Générateur congruentiel linéaire : mêmes scènes d'une exécution et d'une machine à l'autre */
+float benchRandom() {
+	benchSeed = benchSeed * 1103515245u + 12345u;
+	return ((benchSeed >> 8) & 0xFFFF) / 32767.5f - 1.f;
+}
+
+double elapsedMilliseconds(long long start) {
+	return (getTimeNanoseconds() - start) / 1e6;
+}
+
+void printBenchHeader() {
+	printf("program,scene,variant,vertices,instances,build_ms,upload_ms,draw_ms,fps,vertices_per_s,memory_bytes\n");
+}
+
+void printBenchResult(const BenchResult* result) {
+	double fps = result->drawMs > 0 ? 1000. / result->drawMs : 0;
+	printf("%s,%s,%s,%u,%u,%.3f,%.3f,%.3f,%.1f,%.0f,%lu\n", benchProgram, result->scene, result->variant,
+		result->vertices, result->instances, result->buildMs, result->uploadMs, result->drawMs,
+		fps, fps * result->vertices, (unsigned long) result->memory);
+	fflush(stdout);
+}
+
+/* Dessine BENCH_FRAMES images avec draw(data) et renvoie la durée moyenne d'une image en millisecondes */
+double benchDraw(void (*draw)(void*), void* data) {
+	int i;
+	glFinish();
+	long long start = getTimeNanoseconds();
+	for (i = 0; i < BENCH_FRAMES; ++i) {
+		glClear(GL_COLOR_BUFFER_BIT);
+		draw(data);
+		glFinish();
+	}
+	return elapsedMilliseconds(start) / BENCH_FRAMES;
+}
+
+void benchDrawPrimitives(void* data) {
+	drawPrimitives((const PrimitiveList*) data);
+}
+
+void benchDrawLandmarks(void* data) {
+	drawLandmarks();
+}
+
+/*
+BENCH_POINTS points d'un même type répartis en BENCH_PRIMITIVES primitives. Les GL_POLYGON sont des étoiles : sommets
+dans l'ordre des angles, à une distance tirée au hasard du centre. Le contour est simple et concave, comme un dessin
+réel ; des points tirés au hasard donneraient un polygone qui se recoupe, sans oreille, et la mesure d'envoi ne
+compterait plus que les échecs de la découpe d'oreilles. Le temps de la découpe est aussi donné sur une ligne à part.
+*/
+void benchPrimitives(GLenum primitiveType, const char* name) {
+	const unsigned int perPrimitive = BENCH_POINTS / BENCH_PRIMITIVES;
+	unsigned int i, j;
+	BenchResult result = {"primitives", name, BENCH_POINTS, BENCH_PRIMITIVES, 0, 0, 0, 0};
+	Arena arena;
+	PrimitiveList list;
+	initArena(&arena);
+	initPrimitiveList(&list);
+	benchSeed = 1;
+
+	long long start = getTimeNanoseconds();
+	for (i = 0; i < BENCH_PRIMITIVES; ++i) {
+		Primitive* primitive = allocPrimitive(&arena, primitiveType);
+		if (!primitive) {
+			break;
+		}
+		addPrimitive(primitive, &list);
+		float x = benchRandom();
+		float y = benchRandom();
+		for (j = 0; j < perPrimitive; ++j) {
+			float dx, dy;
+			if (primitiveType == GL_POLYGON) {
+				float angle = 2 * M_PI * j / perPrimitive;
+				float radius = BENCH_SPREAD * (0.75f + 0.25f * benchRandom());
+				dx = radius * cos(angle);
+				dy = radius * sin(angle);
+			} else {
+				dx = BENCH_SPREAD * benchRandom();
+				dy = BENCH_SPREAD * benchRandom();
+			}
+			addPointToPrimitive(primitive, x + dx, y + dy, (unsigned char) (i * 37), (unsigned char) (j * 11), 200);
+		}
+	}
+	result.buildMs = elapsedMilliseconds(start);
+
+	start = getTimeNanoseconds();
+	drawPrimitives(&list);
+	glFinish();
+	result.uploadMs = elapsedMilliseconds(start);
+
+	result.drawMs = benchDraw(benchDrawPrimitives, &list);
+	result.memory = arenaBytes(&arena) + BENCH_POINTS * sizeof(Vertex);
+	const Primitive* primitive;
+	for (primitive = list.head; primitive; primitive = primitive->next) {
+		result.memory += primitive->indexCount * sizeof(unsigned int);
+	}
+	printBenchResult(&result);
+
+	if (primitiveType == GL_POLYGON) {
+		/* La découpe d'oreilles fait l'essentiel de l'envoi des polygones : on la mesure aussi seule, sans OpenGL */
+		BenchResult triangulation = {"primitives", "polygon_triangulation", BENCH_POINTS, BENCH_PRIMITIVES, 0, 0, 0, 0};
+		float* points = (float*) malloc(2 * perPrimitive * sizeof(float));
+		unsigned int* triangles = (unsigned int*) malloc(3 * perPrimitive * sizeof(unsigned int));
+		if (points && triangles) {
+			start = getTimeNanoseconds();
+			for (primitive = list.head; primitive; primitive = primitive->next) {
+				unsigned int n = primitiveVertexCount(primitive);
+				for (j = 0; j < n; ++j) {
+					primitiveVertex(primitive, j, &points[2 * j], &points[2 * j + 1]);
+				}
+				triangulation.memory += triangulatePolygon(points, n, triangles) * sizeof(unsigned int);
+			}
+			triangulation.buildMs = elapsedMilliseconds(start);
+			printBenchResult(&triangulation);
+		}
+		free(points);
+		free(triangles);
+	}
+	deletePrimitive(&list, &arena);
+}
+
+/* Grand dessin dont on ne voit qu'une partie : tout est dessiné, ou seulement ce que l'index spatial trouve à l'écran */
+typedef struct BenchCulling {
+	PrimitiveList list;
+	SpatialGrid grid;
+} BenchCulling;
+
+void benchDrawAll(void* data) {
+	drawPrimitives(&((BenchCulling*) data)->list);
+}
+
+void benchDrawVisible(void* data) {
+	BenchCulling* culling = (BenchCulling*) data;
+	drawVisiblePrimitives(&culling->list, &culling->grid);
+}
+
+void benchCulling() {
+	unsigned int i, j;
+	BenchResult all = {"culling", "all", BENCH_POINTS, BENCH_CULLED_PRIMITIVES, 0, 0, 0, 0};
+	BenchResult visible = {"culling", "visible", 0, 0, 0, 0, 0, 0};
+	Arena arena;
+	BenchCulling culling;
+	initArena(&arena);
+	initPrimitiveList(&culling.list);
+	initSpatialGrid(&culling.grid, BENCH_CELL_SIZE);
+	benchSeed = 1;
+
+	long long start = getTimeNanoseconds();
+	for (i = 0; i < BENCH_CULLED_PRIMITIVES; ++i) {
+		Primitive* primitive = allocPrimitive(&arena, GL_LINE_STRIP);
+		if (!primitive) {
+			break;
+		}
+		addPrimitive(primitive, &culling.list);
+		float x = BENCH_CULLED_EXTENT * benchRandom();
+		float y = BENCH_CULLED_EXTENT * benchRandom();
+		for (j = 0; j < BENCH_POINTS / BENCH_CULLED_PRIMITIVES; ++j) {
+			addPointToPrimitive(primitive, x + BENCH_SPREAD * benchRandom(), y + BENCH_SPREAD * benchRandom(),
+				(unsigned char) (i * 37), (unsigned char) (j * 11), 200);
+		}
+	}
+	all.buildMs = elapsedMilliseconds(start);
+
+	start = getTimeNanoseconds();
+	drawPrimitives(&culling.list);
+	glFinish();
+	all.uploadMs = elapsedMilliseconds(start);
+	all.drawMs = benchDraw(benchDrawAll, &culling);
+	all.memory = arenaBytes(&arena) + BENCH_POINTS * sizeof(Vertex);
+	printBenchResult(&all);
+
+	start = getTimeNanoseconds();
+	syncSpatialGrid(&culling.grid, &culling.list);
+	visible.buildMs = elapsedMilliseconds(start);
+	visible.drawMs = benchDraw(benchDrawVisible, &culling);
+	for (i = 0; i < culling.grid.nbFound; ++i) {
+		visible.vertices += primitiveVertexCount(culling.grid.found[i]);
+	}
+	visible.instances = culling.grid.nbFound;
+	visible.memory = all.memory + culling.grid.entriesCapacity * sizeof(GridEntry);
+	printBenchResult(&visible);
+
+	deleteSpatialGrid(&culling.grid);
+	deletePrimitive(&culling.list, &arena);
+}
+
+/* Traits denses (points bien plus serrés que les pixels) : dessinés en entier, puis simplifiés à la taille des pixels */
+void benchSimplification() {
+	unsigned int i, j;
+	BenchResult full = {"simplification", "full", BENCH_POINTS, BENCH_STROKES, 0, 0, 0, 0};
+	BenchResult simplified = {"simplification", "simplified", 0, BENCH_STROKES, 0, 0, 0, 0};
+	Arena arena;
+	BenchCulling strokes;
+	initArena(&arena);
+	initPrimitiveList(&strokes.list);
+	initSpatialGrid(&strokes.grid, BENCH_CELL_SIZE);
+	benchSeed = 1;
+
+	long long start = getTimeNanoseconds();
+	for (i = 0; i < BENCH_STROKES; ++i) {
+		Primitive* primitive = allocPrimitive(&arena, GL_LINE_STRIP);
+		if (!primitive) {
+			break;
+		}
+		addPrimitive(primitive, &strokes.list);
+		float x = 0.8f * benchRandom();
+		float y = 0.8f * benchRandom();
+		for (j = 0; j < BENCH_POINTS / BENCH_STROKES; ++j) {
+			x += BENCH_STROKE_STEP * benchRandom();
+			y += BENCH_STROKE_STEP * benchRandom();
+			addPointToPrimitive(primitive, x, y, (unsigned char) (i * 37), (unsigned char) (j * 11), 200);
+		}
+	}
+	full.buildMs = elapsedMilliseconds(start);
+
+	start = getTimeNanoseconds();
+	drawPrimitives(&strokes.list);
+	glFinish();
+	full.uploadMs = elapsedMilliseconds(start);
+	full.drawMs = benchDraw(benchDrawAll, &strokes);
+	full.memory = arenaBytes(&arena) + BENCH_POINTS * sizeof(Vertex);
+	printBenchResult(&full);
+
+	start = getTimeNanoseconds();
+	benchDrawVisible(&strokes);
+	glFinish();
+	simplified.uploadMs = elapsedMilliseconds(start);
+	simplified.drawMs = benchDraw(benchDrawVisible, &strokes);
+	const Primitive* primitive;
+	for (primitive = strokes.list.head; primitive; primitive = primitive->next) {
+		simplified.vertices += primitive->lodCount ? primitive->lodCount : primitive->vboCount;
+	}
+	simplified.memory = full.memory + simplified.vertices * sizeof(Vertex);
+	printBenchResult(&simplified);
+
+	deleteSpatialGrid(&strokes.grid);
+	deletePrimitive(&strokes.list, &arena);
+}
+
+/*
+Cercles découpés à l'avance en BENCH_CIRCLE_SEGMENTS segments, puis les mêmes cercles en courbes de Bézier cubiques
+(13 points de contrôle) découpées à la taille des pixels au moment du dessin.
+*/
+void benchCurves() {
+	unsigned int i, j, k;
+	BenchResult segments = {"curves", "segments", BENCH_CIRCLES * BENCH_CIRCLE_SEGMENTS, BENCH_CIRCLES, 0, 0, 0, 0};
+	BenchResult curves = {"curves", "adaptive", 0, BENCH_CIRCLES, 0, 0, 0, 0};
+	BenchCulling scenes[2];
+	Arena arenas[2];
+
+	for (k = 0; k < 2; ++k) {
+		BenchResult* result = k ? &curves : &segments;
+		initArena(&arenas[k]);
+		initPrimitiveList(&scenes[k].list);
+		initSpatialGrid(&scenes[k].grid, BENCH_CELL_SIZE);
+		benchSeed = 1;
+		long long start = getTimeNanoseconds();
+		for (i = 0; i < BENCH_CIRCLES; ++i) {
+			Primitive* primitive = allocPrimitive(&arenas[k], k ? PRIMITIVE_CUBIC_BEZIER : GL_LINE_LOOP);
+			if (!primitive) {
+				break;
+			}
+			addPrimitive(primitive, &scenes[k].list);
+			float x = 0.9f * benchRandom();
+			float y = 0.9f * benchRandom();
+			float radius = 0.01f + 0.05f * (benchRandom() + 1);
+			unsigned char r = (unsigned char) (i * 37);
+			if (!k) {
+				for (j = 0; j < BENCH_CIRCLE_SEGMENTS; ++j) {
+					float angle = 2 * M_PI * j / BENCH_CIRCLE_SEGMENTS;
+					addPointToPrimitive(primitive, x + radius * cosf(angle), y + radius * sinf(angle), r, 120, 200);
+				}
+				continue;
+			}
+			addPointToPrimitive(primitive, x + radius, y, r, 120, 200);
+			for (j = 0; j < 4; ++j) {
+				float a0 = j * M_PI / 2;
+				float a1 = (j + 1) * M_PI / 2;
+				addPointToPrimitive(primitive, x + radius * (cosf(a0) - CIRCLE_KAPPA * sinf(a0)),
+					y + radius * (sinf(a0) + CIRCLE_KAPPA * cosf(a0)), r, 120, 200);
+				addPointToPrimitive(primitive, x + radius * (cosf(a1) + CIRCLE_KAPPA * sinf(a1)),
+					y + radius * (sinf(a1) - CIRCLE_KAPPA * cosf(a1)), r, 120, 200);
+				addPointToPrimitive(primitive, x + radius * cosf(a1), y + radius * sinf(a1), r, 120, 200);
+			}
+		}
+		result->buildMs = elapsedMilliseconds(start);
+
+		start = getTimeNanoseconds();
+		benchDrawVisible(&scenes[k]);
+		glFinish();
+		result->uploadMs = elapsedMilliseconds(start);
+		result->drawMs = benchDraw(benchDrawVisible, &scenes[k]);
+		const Primitive* primitive;
+		for (primitive = scenes[k].list.head; primitive; primitive = primitive->next) {
+			result->memory += primitive->vboCount * sizeof(Vertex);
+			if (k) {
+				result->vertices += primitive->lodCount;
+				result->memory += primitive->lodCount * sizeof(Vertex);
+			}
+		}
+		result->memory += arenaBytes(&arenas[k]);
+		printBenchResult(result);
+	}
+
+	for (k = 0; k < 2; ++k) {
+		deleteSpatialGrid(&scenes[k].grid);
+		deletePrimitive(&scenes[k].list, &arenas[k]);
+	}
+}
+
+/* Repère aux graduations très serrées, reconstruit (et renvoyé au GPU) comme lors d'un redimensionnement */
+void benchLandmarks() {
+	BenchResult result = {"landmarks", "dense", 0, 1, 0, 0, 0, 0};
+	long long start = getTimeNanoseconds();
+	buildLandmarks(-1, 1, -1, 1, BENCH_LANDMARK_SPACING, 0.01);
+	glFinish();
+	result.buildMs = elapsedMilliseconds(start);
+	result.vertices = landmarksCount;
+	result.drawMs = benchDraw(benchDrawLandmarks, NULL);
+	result.memory = landmarksCount * sizeof(Vertex);
+	printBenchResult(&result);
+}
+
+/* Scènes communes aux programmes de dessin ; chacun peut ajouter les siennes à la suite */
+/* Prépare les matrices et écrit l'en-tête du CSV, avant les scènes d'un programme qui ne lance pas runBenchmark() */
+void beginBenchmark(const char* program) {
+	benchProgram = program;
+
+	/* Les scènes sont placées directement dans [-1, 1] x [-1, 1] */
+	glMatrixMode(GL_PROJECTION);
+	glLoadIdentity();
+	glMatrixMode(GL_MODELVIEW);
+	glLoadIdentity();
+
+	printBenchHeader();
+}
+
+void runBenchmark(const char* program) {
+	static const GLenum TYPES[] = {GL_POINTS, GL_LINES, GL_LINE_STRIP, GL_LINE_LOOP, GL_TRIANGLES,
+		GL_TRIANGLE_STRIP, GL_TRIANGLE_FAN, GL_QUADS, GL_POLYGON};
+	static const char* TYPE_NAMES[] = {"points", "lines", "line_strip", "line_loop", "triangles",
+		"triangle_strip", "triangle_fan", "quads", "polygon"};
+	unsigned int i;
+	beginBenchmark(program);
+	for (i = 0; i < sizeof(TYPES) / sizeof(TYPES[0]); ++i) {
+		benchPrimitives(TYPES[i], TYPE_NAMES[i]);
+	}
+	benchCulling();
+	benchSimplification();
+	benchCurves();
+	benchLandmarks();
+}
+
+/*
+Mode sans fenêtre (--headless) : pas de SDL_SetVideoMode(), mais un contexte OpenGL EGL sans surface (Mesa, y compris
+llvmpipe) et un framebuffer hors écran de la taille de la fenêtre. Chaque image peut être écrite en PPM (--dump).
+*/
+int headless = 0;
+unsigned int headlessFrames = 1;
+static const char* dumpPrefix = NULL; // préfixe des fichiers PPM, NULL pour ne rien écrire
+unsigned int frameNumber = 0;
+
+static EGLDisplay headlessDisplay = EGL_NO_DISPLAY;
+static EGLContext headlessContext = EGL_NO_CONTEXT;
+static GLuint headlessFramebuffer = 0;
+static GLuint headlessColorbuffer = 0;
+
+int createHeadlessContext(unsigned int width, unsigned int height) {
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (getPlatformDisplay) {
+		headlessDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+	}
+	if (headlessDisplay == EGL_NO_DISPLAY) {
+		headlessDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	}
+	if (headlessDisplay == EGL_NO_DISPLAY || !eglInitialize(headlessDisplay, NULL, NULL)) {
+		headlessDisplay = EGL_NO_DISPLAY;
+		return 0;
+	}
+
+	const EGLint attributes[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_RED_SIZE, 8,
+		EGL_GREEN_SIZE, 8,
+		EGL_BLUE_SIZE, 8,
+		EGL_NONE
+	};
+	EGLConfig config;
+	EGLint nbConfigs = 0;
+	if (!eglBindAPI(EGL_OPENGL_API) || !eglChooseConfig(headlessDisplay, attributes, &config, 1, &nbConfigs) || nbConfigs == 0) {
+		eglTerminate(headlessDisplay);
+		headlessDisplay = EGL_NO_DISPLAY;
+		return 0;
+	}
+	headlessContext = eglCreateContext(headlessDisplay, config, EGL_NO_CONTEXT, NULL);
+	if (headlessContext == EGL_NO_CONTEXT || !eglMakeCurrent(headlessDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, headlessContext)) {
+		if (headlessContext != EGL_NO_CONTEXT) {
+			eglDestroyContext(headlessDisplay, headlessContext);
+			headlessContext = EGL_NO_CONTEXT;
+		}
+		eglTerminate(headlessDisplay);
+		headlessDisplay = EGL_NO_DISPLAY;
+		return 0;
+	}
+
+	/* Sans surface, il n'y a pas de framebuffer par défaut : on dessine dans un renderbuffer */
+	glGenFramebuffers(1, &headlessFramebuffer);
+	glGenRenderbuffers(1, &headlessColorbuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, headlessColorbuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glBindFramebuffer(GL_FRAMEBUFFER, headlessFramebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, headlessColorbuffer);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		destroyHeadlessContext();
+		return 0;
+	}
+	glViewport(0, 0, width, height);
+	return 1;
+}
+
+void destroyHeadlessContext() {
+	if (headlessContext == EGL_NO_CONTEXT) {
+		return;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	glDeleteRenderbuffers(1, &headlessColorbuffer);
+	glDeleteFramebuffers(1, &headlessFramebuffer);
+	headlessColorbuffer = 0;
+	headlessFramebuffer = 0;
+	eglMakeCurrent(headlessDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	eglDestroyContext(headlessDisplay, headlessContext);
+	eglTerminate(headlessDisplay);
+	headlessContext = EGL_NO_CONTEXT;
+	headlessDisplay = EGL_NO_DISPLAY;
+}
+
+/* Écrit le framebuffer courant dans un fichier PPM binaire (lignes remises dans l'ordre haut -> bas) */
+int writeFramePPM(const char* filename, unsigned int width, unsigned int height) {
+	unsigned int y;
+	unsigned char* pixels = (unsigned char*) malloc(3 * width * height);
+	if (!pixels) {
+		return 0;
+	}
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+
+	FILE* file = fopen(filename, "wb");
+	if (!file) {
+		free(pixels);
+		return 0;
+	}
+	fprintf(file, "P6\n%u %u\n255\n", width, height);
+	for (y = height; y > 0; --y) {
+		fwrite(pixels + 3 * width * (y - 1), 1, 3 * width, file);
+	}
+	fclose(file);
+	free(pixels);
+	return 1;
+}
+
+/* Remplace SDL_GL_SwapBuffers() : en mode sans fenêtre, l'image est éventuellement écrite sur disque */
+void swapBuffers() {
+	if (!headless) {
+		SDL_GL_SwapBuffers();
+	} else if (dumpPrefix) {
+		char filename[256];
+		snprintf(filename, sizeof(filename), "%s%04u.ppm", dumpPrefix, frameNumber);
+		if (!writeFramePPM(filename, WINDOW_WIDTH, WINDOW_HEIGHT)) {
+			fprintf(stderr, "Impossible d'écrire %s\n", filename);
+		}
+	}
+	frameNumber++;
+}
+
+static const unsigned char COLORS[] = {
+	255, 255, 255,
+	0, 0, 0,
+	255, 0, 0,
+	0, 255, 0,
+	0, 0, 255,
+	255, 255, 0,
+	0, 255, 255,
+	255, 0, 255
+};
+
+static const unsigned int NB_COLORS = sizeof(COLORS) / (3 * sizeof(unsigned char));
+
+void drawColorPalette() {
+	int i;
+	float dx = 2.f / NB_COLORS; // dx = "delta x"
+	glBegin(GL_QUADS);
+	for(i = 0; i < NB_COLORS; ++i) {
+		glColor3ubv(COLORS + i * 3);
+		glVertex2f(-1 + i * dx, -1);
+		glVertex2f(-1 + (i + 1) * dx, -1);
+		glVertex2f(-1 + (i + 1) * dx, 1);
+		glVertex2f(-1 + i  * dx, 1);
+	}
+	glEnd();
+}
+
+/* Un évènement modifie-t-il ce qui est affiché ? */
+int isSceneEvent(const SDL_Event* e) {
+	switch(e->type) {
+		case SDL_ACTIVEEVENT:
+		case SDL_KEYDOWN:
+		case SDL_KEYUP:
+		case SDL_MOUSEBUTTONDOWN:
+		case SDL_MOUSEBUTTONUP:
+		case SDL_VIDEORESIZE:
+		case SDL_VIDEOEXPOSE:
+			return 1;
+		default:
+			return 0;
+	}
+}
+
+Uint32 pushWakeUpEvent(Uint32 interval, void* param) {
+	SDL_Event wakeUp;
+	wakeUp.type = SDL_USEREVENT;
+	wakeUp.user.code = 0;
+	wakeUp.user.data1 = NULL;
+	wakeUp.user.data2 = NULL;
+	SDL_PushEvent(&wakeUp);
+	return 0; // minuterie à usage unique
+}
+
+/* SDL_WaitEvent() avec délai maximal : une minuterie réveille la boucle si rien n'arrive */
+int waitEventTimeout(SDL_Event* e, Uint32 timeout) {
+	SDL_TimerID timer = SDL_AddTimer(timeout, pushWakeUpEvent, NULL);
+	int result = SDL_WaitEvent(e);
+	if (timer) {
+		SDL_RemoveTimer(timer);
+	}
+	return result;
+}
+
+/* Valeur entière d'une option, entre min et max ; arrête le programme si argument n'en est pas une */
+unsigned int parseCountArgument(const char* option, const char* argument, long min, long max) {
+	char* end;
+	errno = 0;
+	long value = strtol(argument, &end, 10);
+	if (end == argument || *end || errno == ERANGE || value < min || value > max) {
+		fprintf(stderr, "%s attend un nombre entier entre %ld et %ld (reçu : %s). Fin du programme.\n", option, min, max,
+			argument);
+		exit(EXIT_FAILURE);
+	}
+	return (unsigned int) value;
+}
+
+/*
+Options communes : --headless <nombre d'images>, --dump <préfixe des fichiers PPM>, --profile <fichier CSV>, --bench,
+--fps <images par seconde, 0 pour ne pas limiter> et --vsync. Lit l'option argv[*i] et ses valeurs, en avançant *i ;
+renvoie 0 si l'option n'en fait pas partie.
+*/
+int parseCommonArgument(int argc, char** argv, int* i) {
+	if (!strcmp(argv[*i], "--headless") && *i + 1 < argc) {
+		headless = 1;
+		headlessFrames = parseCountArgument(argv[*i], argv[*i + 1], 1, INT_MAX);
+		++*i;
+	} else if (!strcmp(argv[*i], "--dump") && *i + 1 < argc) {
+		dumpPrefix = argv[++*i];
+	} else if (!strcmp(argv[*i], "--profile") && *i + 1 < argc) {
+		profileFile = argv[++*i];
+	} else if (!strcmp(argv[*i], "--bench")) {
+		benchmark = 1;
+	} else if (!strcmp(argv[*i], "--fps") && *i + 1 < argc) {
+		FRAMERATE = parseCountArgument(argv[*i], argv[*i + 1], 0, 1000000000);
+		++*i;
+	} else if (!strcmp(argv[*i], "--vsync")) {
+		vsync = 1;
+	} else {
+		return 0;
+	}
+	return 1;
+}
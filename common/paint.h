@@ -0,0 +1,271 @@
+/*
+Code commun aux programmes de dessin (tp2/exo2 et tp3) : mémoire du dessin, primitives et leurs VBO, courbes,
+triangulation, index spatial, caméra, repère, cadence des images, profilage, banc d'essai et mode sans fenêtre.
+Chaque programme garde sa boucle d'affichage et ce qui lui est propre (historique, journal et fichiers de dessin pour
+tp2, bras articulé pour tp3). tp4 n'en prend que les options, la cadence des images et le mode sans fenêtre.
+*/
+#ifndef PAINT_H
+#define PAINT_H
+
+#ifndef GL_GLEXT_PROTOTYPES
+#define GL_GLEXT_PROTOTYPES // glGenBuffers & co. (OpenGL 1.5)
+#endif
+#include <SDL/SDL.h>
+#include <GL/gl.h>
+#include <GL/glu.h>
+#include <stdio.h>
+#include <limits.h>
+
+/* Dimensions de la fenêtre */
+extern unsigned int WINDOW_WIDTH;
+extern unsigned int WINDOW_HEIGHT;
+
+/* Nombre d'images par seconde visé (0 : pas de limite) et synchronisation verticale */
+extern unsigned int FRAMERATE;
+extern int vsync;
+
+/* Arène : blocs dans lesquels la mémoire d'un dessin est découpée séquentiellement */
+typedef struct ArenaChunk {
+	struct ArenaChunk* next;
+	size_t capacity;
+	size_t used;
+} ArenaChunk;
+
+typedef struct Arena {
+	ArenaChunk* chunks; // le bloc en tête est celui où l'on découpe
+} Arena;
+
+void initArena(Arena* arena);
+void* arenaAlloc(Arena* arena, size_t size);
+void clearArena(Arena* arena);
+size_t arenaBytes(const Arena* arena);
+
+/* Les points d'une primitive sont stockés dans des tableaux contigus (x, y et couleurs séparés)
+   plutôt que dans une liste chaînée : un ajout coûte O(1) amorti et le parcours reste linéaire en mémoire. */
+typedef struct PointArray {
+	float* x;
+	float* y;
+	unsigned char* rgb; // 3 composantes par point, à la suite
+	unsigned int count;
+	unsigned int capacity;
+	int dirty; // modifié depuis le dernier envoi au GPU
+	Arena* arena; // arène qui fournit la mémoire des tableaux
+} PointArray;
+
+/* Boîte englobante alignée sur les axes, vide tant que min > max */
+typedef struct Box {
+	float minX, minY, maxX, maxY;
+} Box;
+
+#define LOD_NONE INT_MIN
+#define LOD_MIN_POINTS 256 // en deçà, une ligne est toujours dessinée en entier
+
+/*
+Courbes : types de primitives en plus de ceux d'OpenGL. Seuls les points de contrôle sont stockés ; la courbe est
+découpée en segments au moment du dessin. Les points qui ne complètent pas un dernier morceau sont ignorés.
+*/
+#define PRIMITIVE_QUADRATIC_BEZIER 0x10000 // p0 p1 p2, puis p2 p3 p4... : un morceau tous les 2 points
+#define PRIMITIVE_CUBIC_BEZIER 0x10001 // p0 p1 p2 p3, puis p3 p4 p5 p6... : un morceau tous les 3 points
+#define PRIMITIVE_CATMULL_ROM 0x10002 // spline qui passe par tous ses points
+#define CIRCLE_KAPPA 0.5522847f // 4/3 (sqrt(2) - 1) : un quart de cercle en Bézier cubique s'écarte de moins de 0,03 %
+
+typedef struct Primitive{
+	GLenum primitiveType;
+	PointArray points;
+	const struct Vertex* fileVertices; // sommets lus tels quels dans un fichier projeté en mémoire, NULL sinon
+	unsigned int fileCount;
+	GLuint vbo; // 0 tant que la primitive n'a jamais été envoyée au GPU
+	unsigned int vboCount; // nombre de sommets présents dans le VBO
+	GLuint lodVbo; // lignes denses simplifiées, ou segments d'une courbe, au niveau de zoom lodLevel
+	unsigned int lodCount; // sommets de lodVbo, 0 si la primitive est dessinée en entier à ce niveau
+	int lodLevel; // niveau de simplification de lodVbo, LOD_NONE s'il est à refaire
+	GLuint indexVbo; // triangles d'un GL_POLYGON, refaits à chaque envoi de ses sommets
+	unsigned int indexCount; // indices de indexVbo, 0 si la primitive est dessinée telle quelle
+	Box bounds; // boîte des sommets (de la courbe pour une courbe) ; elle ne rétrécit pas si des points sont retirés
+	unsigned int index; // position dans la liste
+	struct Primitive* next;
+} Primitive;
+
+/* Liste de primitives : tête, queue et taille, pour ajouter en O(1) et dessiner dans l'ordre d'ajout */
+typedef struct PrimitiveList {
+	Primitive* head;
+	Primitive* tail;
+	unsigned int count;
+} PrimitiveList;
+
+/* Sommet entrelacé tel qu'il est stocké dans les VBO */
+typedef struct Vertex {
+	float x, y;
+	unsigned char r, g, b, a;
+} Vertex;
+
+Vertex makeVertex(float x, float y, unsigned char r, unsigned char g, unsigned char b);
+void initPoints(PointArray* array, Arena* arena);
+int reservePoints(PointArray* array, unsigned int capacity);
+int addPointToArray(PointArray* array, float x, float y, unsigned char r, unsigned char g, unsigned char b);
+Box emptyBox();
+void extendBox(Box* box, float x, float y);
+int boxesIntersect(const Box* a, const Box* b);
+void drawPoints(const PointArray* array);
+
+Primitive* allocPrimitive(Arena* arena, GLenum primitiveType);
+int isCurveType(GLenum primitiveType);
+void extendPrimitiveBounds(Primitive* primitive, unsigned int i);
+int addPointToPrimitive(Primitive* primitive, float x, float y, unsigned char r, unsigned char g, unsigned char b);
+unsigned int primitiveVertexCount(const Primitive* primitive);
+void primitiveVertex(const Primitive* primitive, unsigned int i, float* x, float* y);
+const unsigned char* primitiveColor(const Primitive* primitive, unsigned int i);
+void initPrimitiveList(PrimitiveList* list);
+void addPrimitive(Primitive* primitive, PrimitiveList* list);
+
+float triangleArea2(const float* points, unsigned int a, unsigned int b, unsigned int c);
+unsigned int triangulatePolygon(const float* points, unsigned int count, unsigned int* triangles);
+void uploadPrimitive(Primitive* primitive);
+int simplifyPrimitive(Primitive* primitive, float pixelSize);
+unsigned int curvePieceCount(const Primitive* primitive);
+void curvePiece(const Primitive* primitive, unsigned int k, float x[4], float y[4], unsigned int* first, unsigned int* last);
+void cubicPoint(const float x[4], const float y[4], float t, float* px, float* py);
+int tessellateCurve(Primitive* primitive, float pixelSize);
+void drawPrimitive(Primitive* primitive, float pixelSize);
+void drawPrimitives(const PrimitiveList* list);
+void deletePrimitiveBuffers(Primitive* primitive);
+void forgetPrimitiveBuffers(Primitive* primitive);
+void deletePrimitive(PrimitiveList* list, Arena* arena);
+
+/* Index spatial : grille uniforme de cellules réparties dans une table de hachage de GRID_BUCKETS alvéoles */
+#define GRID_BUCKETS 4096 // puissance de 2
+
+typedef struct GridEntry {
+	Primitive* primitive;
+	int cellX, cellY;
+	int next; // entrée suivante de la même alvéole, -1 en fin de chaîne
+} GridEntry;
+
+typedef struct SpatialGrid {
+	float cellSize; // côté d'une cellule, en unités du plan
+	int buckets[GRID_BUCKETS]; // première entrée de chaque alvéole, -1 si vide
+	GridEntry* entries;
+	unsigned int nbEntries, entriesCapacity;
+	Primitive** large; // primitives trop étendues pour être rangées dans les cellules
+	unsigned int nbLarge, largeCapacity;
+	Primitive** found; // résultat de la dernière requête, dans l'ordre de la liste
+	unsigned int nbFound, foundCapacity;
+	Primitive* last; // dernière primitive indexée
+	Box lastBounds; // sa boîte quand elle a été indexée
+	unsigned int count; // nombre de primitives indexées
+	int stale; // la liste a changé autrement que par des ajouts
+} SpatialGrid;
+
+void initSpatialGrid(SpatialGrid* grid, float cellSize);
+void deleteSpatialGrid(SpatialGrid* grid);
+void invalidateSpatialGrid(SpatialGrid* grid);
+void syncSpatialGrid(SpatialGrid* grid, const PrimitiveList* list);
+void querySpatialGrid(SpatialGrid* grid, const Box* box);
+
+int viewTransform(float m[6]);
+void unprojectPoint(const float m[6], float ndcX, float ndcY, float* x, float* y);
+Box visibleBox();
+int windowToPlane(float px, float py, float* x, float* y);
+float windowLengthToPlane(float pixels);
+void drawVisiblePrimitives(const PrimitiveList* list, SpatialGrid* grid);
+float segmentDistance2(float px, float py, float ax, float ay, float bx, float by);
+int primitiveNear(const Primitive* primitive, float x, float y, float tolerance);
+Primitive* pickPrimitive(const PrimitiveList* list, SpatialGrid* grid, float x, float y, float tolerance);
+
+/* Caméra 2D : un centre et un zoom, appliqués par la matrice de projection */
+typedef struct Camera {
+	float centerX, centerY;
+	float zoom; // 1 : vue par défaut, 2 : deux fois plus près
+	float halfWidth, halfHeight; // demi-étendue de la vue par défaut, en unités du plan
+} Camera;
+
+void applyCamera(const Camera* camera);
+void panCamera(Camera* camera, float dx, float dy);
+void zoomCamera(Camera* camera, float factor, float x, float y);
+int handleCameraKey(Camera* camera, SDLKey key);
+int handleCameraWheel(Camera* camera, const SDL_MouseButtonEvent* button);
+
+/* Génération du contexte OpenGL, qui change quand SDL_SetVideoMode() en crée un nouveau */
+extern unsigned int contextGeneration;
+int checkContext();
+
+/* Repère (graduations et axes) précalculé dans un VBO */
+void buildLandmarks(float xmin, float xmax, float ymin, float ymax, float spacing, float tickSize);
+void drawLandmarks();
+void deleteLandmarks();
+
+/* Cadence des images sur une horloge monotone en nanosecondes */
+typedef struct FrameScheduler {
+	long long period; // en nanosecondes, 0 si la cadence n'est pas limitée par le programme
+	long long deadline; // échéance de l'image en cours
+} FrameScheduler;
+
+long long getTimeNanoseconds();
+double frameBudgetMilliseconds();
+void initFrameScheduler(FrameScheduler* scheduler);
+void waitNextFrame(FrameScheduler* scheduler);
+
+/* Profilage : les étapes d'une image sont propres à chaque programme, qui les déclare avec initProfiler() */
+#define PROFILE_WINDOW 512
+#define PROFILE_MAX_STAGES 8
+
+typedef struct FrameProfiler {
+	const char* const* stageNames;
+	const unsigned char* stageColors; // 3 composantes par étape
+	unsigned int nbStages;
+	double samples[PROFILE_WINDOW][PROFILE_MAX_STAGES]; // en millisecondes
+	unsigned int count; // nombre total d'images enregistrées
+	double current[PROFILE_MAX_STAGES]; // image en cours
+	long long stageStart; // en nanosecondes
+	int showOverlay;
+} FrameProfiler;
+
+extern FrameProfiler profiler;
+extern const char* profileFile; // fichier CSV écrit en quittant, NULL pour ne rien écrire
+
+void initProfiler(const char* const* stageNames, const unsigned char* stageColors, unsigned int nbStages);
+void beginProfileFrame();
+void endProfileStage(unsigned int stage);
+void endProfileFrame();
+void printProfileSummary(FILE* out);
+int writeProfileCSV(const char* filename);
+void drawProfileOverlay();
+
+/* Banc d'essai (--bench) : une ligne CSV par scène sur la sortie standard */
+typedef struct BenchResult {
+	const char* scene;
+	const char* variant;
+	unsigned int vertices; // sommets envoyés par image
+	unsigned int instances;
+	double buildMs; // construction côté CPU
+	double uploadMs; // premier envoi au GPU
+	double drawMs; // moyenne par image
+	size_t memory; // en octets, CPU et GPU
+} BenchResult;
+
+extern int benchmark;
+extern unsigned int benchSeed;
+
+float benchRandom();
+double elapsedMilliseconds(long long start);
+void printBenchResult(const BenchResult* result);
+double benchDraw(void (*draw)(void*), void* data);
+void beginBenchmark(const char* program);
+void runBenchmark(const char* program);
+
+/* Mode sans fenêtre (--headless) : contexte EGL et framebuffer hors écran, images écrites en PPM (--dump) */
+extern int headless;
+extern unsigned int headlessFrames; // nombre d'images à rendre avant de quitter
+extern unsigned int frameNumber;
+
+int createHeadlessContext(unsigned int width, unsigned int height);
+void destroyHeadlessContext();
+int writeFramePPM(const char* filename, unsigned int width, unsigned int height);
+void swapBuffers();
+int parseCommonArgument(int argc, char** argv, int* i);
+
+void drawColorPalette();
+int isSceneEvent(const SDL_Event* e);
+int waitEventTimeout(SDL_Event* e, Uint32 timeout);
+
+#endif
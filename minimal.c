@@ -18,13 +18,27 @@ typedef struct Point{
     float x, y;// Position 2D du point
     unsigned char r,g,b; // Couleur du point
     struct Point* next;
-} Point, *PointList;
+} Point;
+
+/* Liste de points : tête, queue et taille, pour ajouter en O(1) */
+typedef struct PointList{
+    Point* head;
+    Point* tail;
+    unsigned int count;
+} PointList;
 
 typedef struct Primitive{
 	GLenum primitiveType;
 	PointList points;
 	struct Primitive* next;
-}Primitive, *PrimitiveList;
+}Primitive;
+
+/* Liste de primitives : la queue est la primitive courante, l'ordre d'ajout est l'ordre de dessin */
+typedef struct PrimitiveList{
+    Primitive* head;
+    Primitive* tail;
+    unsigned int count;
+} PrimitiveList;
 
 
 Point* allocPoint(float x, float y, unsigned char r, unsigned char g, unsigned char b){
@@ -40,41 +54,61 @@ Point* allocPoint(float x, float y, unsigned char r, unsigned char g, unsigned c
     return tmp;
 }
 
-void addPointToList(Point* point, PointList* list){
-   /*allocPoint(point->x, point->y, point->r, point->g, point->b);*/
+void initPointList(PointList* list){
+    list->head = NULL;
+    list->tail = NULL;
+    list->count = 0;
+}
 
-    if(*list == NULL){
-        *list = point;
+void addPointToList(Point* point, PointList* list){
+    point->next = NULL;
+    if(list->tail == NULL){
+        list->head = point;
     }else {
-	addPointToList(point,&(*list)->next);
+        list->tail->next = point;
     }
+    list->tail = point;
+    list->count++;
 }
 
-void drawPoints(PointList list){
-	while(list->next != NULL){
-			glColor3ub(list->r,list->g,list->b);
-	                glVertex2f(list->x,list->y);
-			list = list->next;
+void drawPoints(const PointList* list){
+	Point* tmp;
+	for(tmp = list->head; tmp != NULL; tmp = tmp->next){
+		glColor3ub(tmp->r,tmp->g,tmp->b);
+		glVertex2f(tmp->x,tmp->y);
 	}
 }
 
 void deletePoints(PointList* list){
-	while(*list){
-		PointList *tmp = &(*list)->next;		
-		free(list);
-		list = tmp;
-	}		
+	while(list->head){
+		Point* tmp = list->head->next;
+		free(list->head);
+		list->head = tmp;
+	}
+	initPointList(list);
+}
+
+void initPrimitiveList(PrimitiveList* list){
+    list->head = NULL;
+    list->tail = NULL;
+    list->count = 0;
 }
 
-void addPrimitive(Primitive* primitive, PrimitiveList* list){	
-    	primitive->next = *list;
-        *list = primitive;
+void addPrimitive(Primitive* primitive, PrimitiveList* list){
+    	primitive->next = NULL;
+    	if(list->tail == NULL){
+    		list->head = primitive;
+    	}else {
+    		list->tail->next = primitive;
+    	}
+    	list->tail = primitive;
+    	list->count++;
 }
 
 Primitive* allocPrimitive(GLenum primitiveType){
-	Primitive* tmp = (Primitive*) malloc(sizeof(primitiveType));
+	Primitive* tmp = (Primitive*) malloc(sizeof(Primitive));
 	if(tmp!=NULL){
-		tmp->points = NULL;
+		initPointList(&tmp->points);
 		tmp->next = NULL;
 		tmp->primitiveType = primitiveType;
 		return tmp;
@@ -83,23 +117,23 @@ Primitive* allocPrimitive(GLenum primitiveType){
 }
 
 
-void drawPrimitives(PrimitiveList list){
-	while(list){
-		glBegin(list->primitiveType);
-                        glVertex2f(list->points->x, list->points->y);
-               		drawPoints(list->points);
+void drawPrimitives(const PrimitiveList* list){
+	Primitive* tmp;
+	for(tmp = list->head; tmp != NULL; tmp = tmp->next){
+		glBegin(tmp->primitiveType);
+			drawPoints(&tmp->points);
 		glEnd();
-		list = list->next;
 	}
 }
 
 void deletePrimitive(PrimitiveList* list){
-	while(*list){
-		PrimitiveList* tmp= &(*list)->next;
-		deletePoints(&(*list)->points);
-		free(*list);
-		*list = *tmp;
+	while(list->head){
+		Primitive* tmp = list->head->next;
+		deletePoints(&list->head->points);
+		free(list->head);
+		list->head = tmp;
 	}
+	initPrimitiveList(list);
 }
 
 void scene() {
@@ -132,7 +166,8 @@ int main(int argc, char** argv) {
     /* Placer ici le code de dessin */
     glClear(GL_COLOR_BUFFER_BIT);
     
-    PrimitiveList premiere = NULL;
+    PrimitiveList premiere;
+    initPrimitiveList(&premiere);
     addPrimitive(allocPrimitive(GL_POINTS), &premiere);
 
     /* Boucle d'affichage */
@@ -19,7 +19,21 @@ typedef struct Point {
     float x, y;
     unsigned char r, g, b;
     struct Point* next;
-} Point, *PointList;
+} Point;
+
+/* Liste de points : tête, queue et taille, pour ajouter en O(1) sans parcourir la liste */
+typedef struct PointList {
+    Point* head;
+    Point* tail;
+    unsigned int count;
+} PointList;
+
+void initPointList(PointList* list) {
+    assert(list);
+    list->head = NULL;
+    list->tail = NULL;
+    list->count = 0;
+}
 
 Point* allocPoint(float x, float y, unsigned char r, unsigned char g, unsigned char b) {
     /*
@@ -42,37 +56,54 @@ Point* allocPoint(float x, float y, unsigned char r, unsigned char g, unsigned c
 void addPointToList(Point* point, PointList* list) {
     assert(point);
     assert(list);
-    if (*list == NULL) {
-        /* Si le pointeur sur la liste est vide, on le modifie pour le faire pointer sur le point donné en paramètre */
-        *list = point;
+    /* Le point est accroché directement derrière la queue de la liste */
+    point->next = NULL;
+    if (list->tail) {
+        list->tail->next = point;
     } else {
-        /* Sinon, on réapplique la même fonction mais sur le point suivant */
-        addPointToList(point, &(*list)->next);
+        list->head = point;
     }
+    list->tail = point;
+    list->count++;
 }
 
-void drawPoints(PointList list) {
-    while(list) {
-        glColor3ub(list->r, list->g, list->b);
-        glVertex2f(list->x, list->y);
-        list = list->next;
+void drawPoints(const PointList* list) {
+    Point* point;
+    for (point = list->head; point; point = point->next) {
+        glColor3ub(point->r, point->g, point->b);
+        glVertex2f(point->x, point->y);
     }
 }
 
 void deletePoints(PointList* list) {
     assert(list);
-    while (*list) {
-        Point* next = (*list)->next;
-        free(*list);
-        *list = next;
+    while (list->head) {
+        Point* next = list->head->next;
+        free(list->head);
+        list->head = next;
     }
+    initPointList(list);
 }
 
 typedef struct Primitive{
     GLenum primitiveType;
     PointList points;
     struct Primitive* next;
-} Primitive, *PrimitiveList;
+} Primitive;
+
+/* Liste de primitives : la queue est la primitive courante, l'ordre d'ajout est l'ordre de dessin */
+typedef struct PrimitiveList {
+    Primitive* head;
+    Primitive* tail;
+    unsigned int count;
+} PrimitiveList;
+
+void initPrimitiveList(PrimitiveList* list) {
+    assert(list);
+    list->head = NULL;
+    list->tail = NULL;
+    list->count = 0;
+}
 
 Primitive* allocPrimitive(GLenum primitiveType) {
     /*
@@ -84,7 +115,7 @@ Primitive* allocPrimitive(GLenum primitiveType) {
         return NULL;
     }
     primitive->primitiveType = primitiveType;
-    primitive->points = NULL;
+    initPointList(&primitive->points);
     primitive->next = NULL;
     return primitive;
 }
@@ -92,32 +123,34 @@ Primitive* allocPrimitive(GLenum primitiveType) {
 void addPrimitive(Primitive* primitive, PrimitiveList* list) {
     assert(primitive);
     assert(list);
-    if (*list == NULL) {
-        // Si le pointeur sur la liste est vide, on le modifie pour le faire pointer sur la primitive donnée en paramètre
-        *list = primitive;
+    primitive->next = NULL;
+    if (list->tail) {
+        list->tail->next = primitive;
     } else {
-        // Sinon, on réapplique la même fonction mais sur le point suivant
-        addPrimitive(primitive, &(*list)->next);
+        list->head = primitive;
     }
+    list->tail = primitive;
+    list->count++;
 }
 
-void drawPrimitives(PrimitiveList list) {
-    while(list) {
-        glBegin(list->primitiveType);
-        drawPoints(list->points);
+void drawPrimitives(const PrimitiveList* list) {
+    Primitive* primitive;
+    for (primitive = list->head; primitive; primitive = primitive->next) {
+        glBegin(primitive->primitiveType);
+        drawPoints(&primitive->points);
         glEnd();
-        list = list->next;
     }
 }
 
 void deletePrimitive(PrimitiveList* list) {
     assert(list);
-    while(*list) {
-        Primitive* next = (*list)->next;
-        deletePoints(&(*list)->points);
-        free(*list);
-        *list = next;
+    while(list->head) {
+        Primitive* next = list->head->next;
+        deletePoints(&list->head->points);
+        free(list->head);
+        list->head = next;
     }
+    initPrimitiveList(list);
 }
 
 void resizeViewport() {
@@ -175,10 +208,9 @@ int main(int argc, char** argv) {
     glClear(GL_COLOR_BUFFER_BIT);
 
     /* On créé une première primitive par défaut */
-    PrimitiveList primitives = NULL;
-    Primitive* prim = allocPrimitive(GL_POINTS);
-    PrimitiveList lastPrim = prim;
-    addPrimitive(prim, &primitives);
+    PrimitiveList primitives;
+    initPrimitiveList(&primitives);
+    addPrimitive(allocPrimitive(GL_POINTS), &primitives);
 
     int loop = 1;
     int mode = 0; // le mode d'affichage. 0 = le dessin, 1 = la palette
@@ -196,7 +228,7 @@ int main(int argc, char** argv) {
         glClear(GL_COLOR_BUFFER_BIT); // Toujours commencer par clear le buffer
 
         if (mode == 0) {
-            drawPrimitives(primitives); // On dessine la liste de primitives
+            drawPrimitives(&primitives); // On dessine la liste de primitives
         }
         else if (mode == 1) {
             drawColorPalette();
@@ -229,8 +261,8 @@ int main(int argc, char** argv) {
                         unsigned int r = COLORS[currentColor * 3];
                         unsigned int g = COLORS[currentColor * 3 + 1];
                         unsigned int b = COLORS[currentColor * 3 + 2];
-                        /* On ajoute un nouveau point à la liste de la primitive courante */
-                        addPointToList(allocPoint(x, y, r, g, b), &lastPrim->points);
+                        /* On ajoute un nouveau point à la liste de la primitive courante (la dernière ajoutée) */
+                        addPointToList(allocPoint(x, y, r, g, b), &primitives.tail->points);
                     }
                     break;
 
@@ -281,9 +313,7 @@ int main(int argc, char** argv) {
                     }
 
                     if (newPrimitivePressed && currentPrimitiveType != newPrimitiveType) {
-                        prim = allocPrimitive(newPrimitiveType);
-                        lastPrim = prim;
-                        addPrimitive(prim, &primitives);
+                        addPrimitive(allocPrimitive(newPrimitiveType), &primitives);
                         currentPrimitiveType = newPrimitiveType;
                     }
 
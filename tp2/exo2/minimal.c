@@ -1,169 +1,501 @@
-#include <SDL/SDL.h>
-#include <GL/gl.h>
-#include <GL/glu.h>
+#include "paint.h"
 #include <stdlib.h>
-#include <stdio.h>
+#include <string.h>
 #include <assert.h>
+#include <errno.h>
 #include <math.h>
+#include <float.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #define NB_SEGMENTS 100
-/* Dimensions de la fenêtre */
-static unsigned int WINDOW_WIDTH = 800;
-static unsigned int WINDOW_HEIGHT = 600;
 
 /* Nombre de bits par pixel de la fenêtre */
 static const unsigned int BIT_PER_PIXEL = 32;
 
-/* Nombre minimal de millisecondes separant le rendu de deux images */
-static const Uint32 FRAMERATE_MILLISECONDS = 1000 / 60;
+void rotation(float a){
+	glRotatef(a,0.0,0.0,1.0);
+}
 
-typedef struct Point {
-	float x, y;
-	unsigned char r, g, b;
-	struct Point* next;
-} Point, *PointList;
+void taille(float x, float y, float z){
+	glScalef(x,y,z);
+}
 
-typedef struct Primitive{
-	GLenum primitiveType;
-	PointList points;
-	struct Primitive* next;
-} Primitive, *PrimitiveList;
 
-Point* allocPoint(float x, float y, unsigned char r, unsigned char g, unsigned char b) {
-    /*
-    On alloue un espace mémoire suffisant pour pouvoir stocker un point
-    Attention : la fonction malloc() renvoie un void* qu'il faut impérativement caster en Point*.
-    */
-    Point* point = (Point*) malloc(sizeof(Point));
-    if (!point) {
-    	return NULL;
-    }
-    point->x = x;
-    point->y = y;
-    point->r = r;
-    point->g = g;
-    point->b = b;
-    point->next = NULL;
-    return point;
-}
-
-void addPointToList(Point* point, PointList* list) {
-	assert(point);
-	assert(list);
-	if (*list == NULL) {
-        /* Si le pointeur sur la liste est vide, on le modifie pour le faire pointer sur le point donné en paramètre */
-		*list = point;
-	} else {
-        /* Sinon, on réapplique la même fonction mais sur le point suivant */
-		addPointToList(point, &(*list)->next);
+void drawSquare(){
+	glColor3ub(255,0,0);
+	glBegin(GL_QUADS);
+	glVertex2f(-0.5, 0.5);
+	glVertex2f(0.5,0.5);
+	glVertex2f(0.5,-0.5);
+	glVertex2f(-0.5,-0.5);
+	glEnd();
+}
+
+
+/* Espacement et taille des graduations du repère */
+static const float LANDMARK_SPACING = 0.1;
+static const float LANDMARK_TICK_SIZE = 0.01;
+
+
+/* Index spatial du dessin affiché, pour ne dessiner que les primitives visibles et trouver celle sous la souris */
+#define DRAWING_CELL_SIZE 1.f
+#define PICK_TOLERANCE_PIXELS 6 // distance à l'écran au-delà de laquelle un clic ne touche pas une primitive
+
+static SpatialGrid drawingGrid;
+
+/*
+Historique (touches z et y) : une étape ne garde que l'en-tête de la liste (tête, queue, taille) et le nombre de points
+de la primitive de queue. Les primitives et leurs tableaux de points ne sont jamais recopiés : les modifications ne font
+qu'ajouter à la fin, donc chaque étape voit un préfixe des données partagées avec toutes les autres.
+Effacer le dessin ne fait que repartir d'une liste vide : les anciennes primitives restent en mémoire pour l'annulation.
+La mémoire croît ainsi avec le nombre de modifications, et non avec la profondeur de l'historique multipliée par la
+taille du dessin.
+Chaque chaîne de primitives (ce qui est dessiné entre deux effacements) a sa propre arène. Quand plus aucune étape ne
+voit une chaîne, parce que sa dernière étape est sortie de l'historique ou a été abandonnée par une modification après
+une annulation, ses VBO et son arène sont rendus. Les primitives abandonnées d'une chaîne encore visible rendent leurs
+VBO tout de suite et leur mémoire avec la chaîne.
+*/
+#define HISTORY_DEPTH 512
+
+typedef struct HistoryStep {
+	PrimitiveList list;
+	unsigned int tailPoints; // points de la primitive de queue à cette étape
+	unsigned int previousTailPoints; // points, à cette étape, de la primitive de queue de l'étape précédente
+	unsigned int created; // nombre de primitives créées jusqu'à cette étape
+} HistoryStep;
+
+typedef struct History {
+	HistoryStep steps[HISTORY_DEPTH]; // tampon circulaire, indicé par les compteurs ci-dessous
+	unsigned int oldest, current, newest; // oldest <= current <= newest
+	int pending; // le dessin a été modifié depuis la dernière étape
+	Primitive** created; // primitives créées et encore visibles d'une étape, dans l'ordre de création
+	unsigned int nbCreated;
+	unsigned int capacity;
+	Arena** arenas; // arènes allouées pour les chaînes, en plus de l'arène du dessin
+	unsigned int nbArenas;
+	unsigned int arenaCapacity;
+} History;
+
+static History history;
+
+HistoryStep* historyStep(unsigned int index) {
+	return &history.steps[index % HISTORY_DEPTH];
+}
+
+unsigned int tailPoints(const PrimitiveList* list) {
+	return list->tail ? list->tail->points.count : 0;
+}
+
+void setPointCount(Primitive* primitive, unsigned int count) {
+	if (primitive && primitive->points.count != count) {
+		primitive->points.count = count;
+		primitive->points.dirty = 1;
 	}
 }
 
-void rotation(float a){
-	glRotatef(a,0.0,0.0,1.0);
+void registerPrimitive(Primitive* primitive) {
+	if (history.nbCreated == history.capacity) {
+		unsigned int capacity = history.capacity ? 2 * history.capacity : 64;
+		Primitive** created = (Primitive**) realloc(history.created, capacity * sizeof(Primitive*));
+		if (!created) {
+			return;
+		}
+		history.created = created;
+		history.capacity = capacity;
+	}
+	history.created[history.nbCreated++] = primitive;
 }
 
-void taille(float x, float y, float z){
-	glScalef(x,y,z);
+/* Supprime les VBO des primitives enregistrées à partir de first (elles ne sont plus accessibles) */
+void deleteCreatedPrimitives(unsigned int first) {
+	unsigned int i;
+	for (i = first; i < history.nbCreated; ++i) {
+		deletePrimitiveBuffers(history.created[i]);
+	}
+	history.nbCreated = first;
 }
 
+/*
+Arène dans laquelle ajouter une primitive à list : celle de sa chaîne, ou pour une liste vide celle d'une nouvelle chaîne.
+L'arène du dessin sert dès qu'elle est vide, les autres sont allouées ici.
+*/
+Arena* chainArena(const PrimitiveList* list, Arena* drawing) {
+	if (list->head) {
+		return list->head->points.arena;
+	}
+	if (!drawing->chunks) {
+		return drawing;
+	}
+	if (history.nbArenas == history.arenaCapacity) {
+		unsigned int capacity = history.arenaCapacity ? 2 * history.arenaCapacity : 8;
+		Arena** arenas = (Arena**) realloc(history.arenas, capacity * sizeof(Arena*));
+		if (!arenas) {
+			return NULL;
+		}
+		history.arenas = arenas;
+		history.arenaCapacity = capacity;
+	}
+	Arena* arena = (Arena*) malloc(sizeof(Arena));
+	if (!arena) {
+		return NULL;
+	}
+	initArena(arena);
+	history.arenas[history.nbArenas++] = arena;
+	return arena;
+}
 
-void drawPoints(PointList list) {
-	while(list) {
-		glColor3ub(list->r, list->g, list->b);
-		glVertex2f(list->x, list->y);
-		list = list->next;
+/* Rend la mémoire d'une chaîne : l'arène du dessin est seulement vidée, les autres sont libérées */
+void releaseArena(Arena* arena) {
+	unsigned int i;
+	clearArena(arena);
+	for (i = 0; i < history.nbArenas; ++i) {
+		if (history.arenas[i] == arena) {
+			free(arena);
+			history.arenas[i] = history.arenas[--history.nbArenas];
+			return;
+		}
 	}
 }
 
-void deletePoints(PointList* list) {
-	assert(list);
-	while (*list) {
-		Point* next = (*list)->next;
-		free(*list);
-		*list = next;
+void deleteChainArenas() {
+	unsigned int i;
+	for (i = 0; i < history.nbArenas; ++i) {
+		clearArena(history.arenas[i]);
+		free(history.arenas[i]);
 	}
+	history.nbArenas = 0;
 }
 
-Primitive* allocPrimitive(GLenum primitiveType) {
-    /*
-    On alloue un espace mémoire suffisant pour pouvoir stocker une primitive
-    Attention : la fonction malloc() renvoie un void* qu'il faut impérativement caster en Primitive*.
-    */
-    Primitive* primitive = (Primitive*) malloc(sizeof(Primitive));
-    if (!primitive) {
-    	return NULL;
-    }
-    primitive->primitiveType = primitiveType;
-    primitive->points = NULL;
-    primitive->next = NULL;
-    return primitive;
-}
-
-void addPrimitive(Primitive* primitive, PrimitiveList* list) {
-	assert(primitive);
-	assert(list);
-	primitive->next = (*list);
-	(*list) = primitive;
+/* Une étape entre oldest et last, ou la liste list, voit-elle la chaîne qui commence par head ? */
+int chainVisible(const Primitive* head, unsigned int last, const PrimitiveList* list) {
+	unsigned int i;
+	if (list->head == head) {
+		return 1;
+	}
+	for (i = history.oldest; i <= last; ++i) {
+		if (historyStep(i)->list.head == head) {
+			return 1;
+		}
+	}
+	return 0;
 }
 
-void drawPrimitives(PrimitiveList list) {
-	while(list) {
-		glBegin(list->primitiveType);
-		drawPoints(list->points);
-		glEnd();
-		list = list->next;
+/*
+Libère une chaîne sortie de l'historique. Les étapes se suivent sans qu'une chaîne revienne après une autre (revenir à
+une chaîne passe par une annulation, et modifier ensuite abandonne les étapes suivantes) : ses primitives sont donc les
+premières créées encore enregistrées.
+*/
+void releaseChain(const Primitive* head, unsigned int last) {
+	Arena* arena = head->points.arena;
+	unsigned int i, n = 0;
+	while (n < history.nbCreated && history.created[n]->points.arena == arena) {
+		deletePrimitiveBuffers(history.created[n]);
+		n++;
+	}
+	memmove(history.created, history.created + n, (history.nbCreated - n) * sizeof(Primitive*));
+	history.nbCreated -= n;
+	for (i = history.oldest; i <= last; ++i) {
+		historyStep(i)->created -= n;
 	}
+	releaseArena(arena);
 }
 
-void deletePrimitive(PrimitiveList* list) {
-	assert(list);
-	while(*list) {
-		Primitive* next = (*list)->next;
-		deletePoints(&(*list)->points);
-		free(*list);
-		*list = next;
+/* L'historique repart de l'état courant du dessin */
+void resetHistory(const PrimitiveList* list) {
+	const Primitive* primitive;
+	history.nbCreated = 0;
+	for (primitive = list->head; primitive; primitive = primitive->next) {
+		registerPrimitive((Primitive*) primitive);
 	}
+	history.oldest = history.current = history.newest = 0;
+	HistoryStep* step = historyStep(0);
+	step->list = *list;
+	step->tailPoints = tailPoints(list);
+	step->previousTailPoints = 0;
+	step->created = history.nbCreated;
+	history.pending = 0;
 }
 
-void drawSquare(){
-	glColor3ub(255,0,0);
-	glBegin(GL_QUADS);
-	glVertex2f(-0.5, 0.5);
-	glVertex2f(0.5,0.5);
-	glVertex2f(0.5,-0.5);
-	glVertex2f(-0.5,-0.5);
-	glEnd();
+void deleteHistory() {
+	deleteCreatedPrimitives(0);
+	free(history.created);
+	history.created = NULL;
+	history.capacity = 0;
+	deleteChainArenas();
+	free(history.arenas);
+	history.arenas = NULL;
+	history.arenaCapacity = 0;
 }
 
+/* Rend toute la mémoire du dessin, historique compris */
+void discardDrawing(PrimitiveList* list, Arena* arena) {
+	deleteCreatedPrimitives(0);
+	deletePrimitive(list, arena);
+	deleteChainArenas();
+	initPrimitiveList(list);
+	resetHistory(list);
+	invalidateSpatialGrid(&drawingGrid);
+}
 
-void drawLandmarks(){
-	float i;
-	glBegin(GL_LINES);
-	for(i=-1; i<1; i+=0.1){
-		glColor3ub(255,255,255);
-		glVertex2f(i,-0.01);
-		glVertex2f(i,0.01);
-		glVertex2f(-0.01,i);
-		glVertex2f(0.01,i);
+/* À appeler avant toute modification : modifier un état annulé abandonne les étapes qui le suivaient */
+void beginEdit() {
+	unsigned int i;
+	if (history.current != history.newest) {
+		deleteCreatedPrimitives(historyStep(history.current)->created);
+        /* Les chaînes commencées après l'étape courante ne sont plus visibles d'aucune étape */
+		const Primitive* kept = historyStep(history.current)->list.head;
+		for (i = history.current + 1; i <= history.newest; ++i) {
+			const Primitive* head = historyStep(i)->list.head;
+			if (head && head != kept && head != historyStep(i - 1)->list.head) {
+				releaseArena(head->points.arena);
+			}
+		}
+		history.newest = history.current;
 	}
+	history.pending = 1;
+}
 
-	glEnd();
+/* Enregistre une étape si le dessin a changé ; renvoie 1 si une étape a été enregistrée */
+int commitHistory(const PrimitiveList* list) {
+	if (!history.pending) {
+		return 0;
+	}
+	const HistoryStep* previous = historyStep(history.current);
+	unsigned int previousTailPoints = previous->list.tail ? previous->list.tail->points.count : 0;
+	history.current = ++history.newest;
+	if (history.newest - history.oldest >= HISTORY_DEPTH) {
+        /* L'étape la plus ancienne sort de l'historique (sa case reçoit la nouvelle étape) */
+		const Primitive* head = historyStep(history.oldest)->list.head;
+		history.oldest++;
+		if (head && !chainVisible(head, history.newest - 1, list)) {
+			releaseChain(head, history.newest - 1);
+		}
+	}
+	HistoryStep* step = historyStep(history.current);
+	step->list = *list;
+	step->tailPoints = tailPoints(list);
+	step->previousTailPoints = previousTailPoints;
+	step->created = history.nbCreated;
+	history.pending = 0;
+	return 1;
 }
 
-void drawLandmark(){
-	glBegin(GL_LINES);
-	glColor3ub(255,0,0);
-	glVertex2f(-1, 0);
-	glVertex2f(1,0);
-	glColor3ub(0,255,0);
-	glVertex2f(0,-1);
-	glVertex2f(0,1);
-	glEnd();
+int undo(PrimitiveList* list) {
+	if (history.current == history.oldest) {
+		return 0;
+	}
+	const HistoryStep* step = historyStep(--history.current);
+	*list = step->list;
+    /* La queue de l'étape est coupée du reste de la chaîne et reprend son nombre de points d'alors */
+	if (list->tail) {
+		list->tail->next = NULL;
+		setPointCount(list->tail, step->tailPoints);
+	}
+	invalidateSpatialGrid(&drawingGrid);
+	return 1;
 }
 
+int redo(PrimitiveList* list) {
+	if (history.current == history.newest) {
+		return 0;
+	}
+	const HistoryStep* previous = historyStep(history.current);
+	const HistoryStep* step = historyStep(++history.current);
+	Primitive* previousTail = previous->list.tail;
+	if (previousTail && previousTail != step->list.tail) {
+		setPointCount(previousTail, step->previousTailPoints);
+        /* Même chaîne : on rattache la primitive créée juste après l'étape précédente */
+		if (step->list.head == previous->list.head && previous->created < history.nbCreated) {
+			previousTail->next = history.created[previous->created];
+		}
+	}
+	*list = step->list;
+	setPointCount(list->tail, step->tailPoints);
+	invalidateSpatialGrid(&drawingGrid);
+	return 1;
+}
 
-void drawCircle(PrimitiveList * primitive){
+/*
+Journal des modifications (--journal) : chaque modification du dessin (nouvelle primitive, couleur, point, effacement),
+chaque étape de l'historique et chaque annulation ou rétablissement est ajoutée à la fin d'un fichier, avec les écritures
+regroupées par le tampon de stdio. Au démarrage, le journal existant est rejoué pour retrouver le dessin après un arrêt
+brutal, sans jamais avoir à enregistrer le dessin entier.
+Les évènements ont une taille fixe : un évènement à moitié écrit en fin de fichier est simplement ignoré.
+Charger un dessin remet le journal à zéro : le fichier chargé est lié à côté du journal (suffixe JOURNAL_SNAPSHOT), qui ne
+contient plus qu'un évènement de chargement suivi des modifications faites depuis.
+*/
+#define JOURNAL_BUFFER_SIZE (64 * 1024)
+#define JOURNAL_SNAPSHOT ".imcd"
+
+typedef enum JournalEventType {
+	JOURNAL_PRIMITIVE, // nouvelle primitive courante
+	JOURNAL_COLOR, // couleur des points suivants
+	JOURNAL_POINT, // point ajouté à la primitive courante
+	JOURNAL_CLEAR, // dessin effacé
+	JOURNAL_STEP, // étape enregistrée dans l'historique
+	JOURNAL_UNDO, // annulation (touche z)
+	JOURNAL_REDO, // rétablissement (touche y)
+	JOURNAL_LOAD // dessin chargé, lu dans la copie liée au journal
+} JournalEventType;
+
+typedef struct JournalEvent {
+	uint8_t type;
+	uint8_t r, g, b;
+	union {
+		uint32_t primitiveType;
+		struct {
+			float x, y;
+		} point;
+	} data;
+} JournalEvent;
+
+typedef struct Journal {
+	FILE* file; // NULL si le journal est désactivé
+	const char* filename;
+	char snapshot[512]; // dernier dessin chargé, que les évènements du journal complètent
+	unsigned char r, g, b; // dernière couleur écrite
+	int hasColor;
+} Journal;
+
+static Journal journal = {NULL, NULL, "", 0, 0, 0, 0};
+static const char* journalPath = NULL;
+
+int openJournal(Journal* journal, const char* filename) {
+	assert(journal);
+	journal->file = fopen(filename, "ab");
+	if (!journal->file) {
+		return 0;
+	}
+	setvbuf(journal->file, NULL, _IOFBF, JOURNAL_BUFFER_SIZE);
+	journal->filename = filename;
+	snprintf(journal->snapshot, sizeof(journal->snapshot), "%s%s", filename, JOURNAL_SNAPSHOT);
+	journal->hasColor = 0;
+	return 1;
+}
+
+void writeJournalEvent(Journal* journal, const JournalEvent* event) {
+	if (journal->file) {
+		fwrite(event, sizeof(JournalEvent), 1, journal->file);
+	}
+}
+
+void journalPrimitive(Journal* journal, GLenum primitiveType) {
+	JournalEvent event;
+	memset(&event, 0, sizeof(event));
+	event.type = JOURNAL_PRIMITIVE;
+	event.data.primitiveType = primitiveType;
+	writeJournalEvent(journal, &event);
+}
+
+/* La couleur n'est écrite que lorsqu'elle change : un point seul tient dans un évènement */
+void journalPoint(Journal* journal, float x, float y, unsigned char r, unsigned char g, unsigned char b) {
+	JournalEvent event;
+	memset(&event, 0, sizeof(event));
+	if (!journal->hasColor || journal->r != r || journal->g != g || journal->b != b) {
+		event.type = JOURNAL_COLOR;
+		event.r = journal->r = r;
+		event.g = journal->g = g;
+		event.b = journal->b = b;
+		journal->hasColor = 1;
+		writeJournalEvent(journal, &event);
+	}
+	event.type = JOURNAL_POINT;
+	event.data.point.x = x;
+	event.data.point.y = y;
+	writeJournalEvent(journal, &event);
+}
+
+/* Évènement sans donnée : effacement, étape de l'historique, annulation ou rétablissement */
+void journalEvent(Journal* journal, JournalEventType type) {
+	JournalEvent event;
+	memset(&event, 0, sizeof(event));
+	event.type = type;
+	writeJournalEvent(journal, &event);
+}
+
+/* Vide le tampon : appelé une fois par tour de boucle, ce qui borne ce qu'un arrêt brutal peut faire perdre */
+void flushJournal(Journal* journal) {
+	if (journal->file) {
+		fflush(journal->file);
+	}
+}
+
+void closeJournal(Journal* journal) {
+	if (journal->file) {
+		fclose(journal->file);
+		journal->file = NULL;
+	}
+}
+
+/* Modifications du dessin, toutes inscrites au journal */
+Primitive* newPrimitive(PrimitiveList* list, Arena* arena, GLenum primitiveType) {
+	beginEdit();
+	Arena* chain = chainArena(list, arena);
+	Primitive* primitive = chain ? allocPrimitive(chain, primitiveType) : NULL;
+	if (!primitive && chain && !list->head) {
+		releaseArena(chain);
+	}
+	if (primitive) {
+		registerPrimitive(primitive);
+		addPrimitive(primitive, list);
+		journalPrimitive(&journal, primitiveType);
+	}
+	return primitive;
+}
+
+int addPoint(PrimitiveList* list, float x, float y, unsigned char r, unsigned char g, unsigned char b) {
+	assert(list);
+	assert(list->tail);
+	beginEdit();
+	if (!addPointToPrimitive(list->tail, x, y, r, g, b)) {
+		return 0;
+	}
+	journalPoint(&journal, x, y, r, g, b);
+	return 1;
+}
+
+/* Les primitives effacées sont gardées pour pouvoir annuler l'effacement */
+void clearDrawing(PrimitiveList* list) {
+	beginEdit();
+	initPrimitiveList(list);
+	invalidateSpatialGrid(&drawingGrid);
+	journalEvent(&journal, JOURNAL_CLEAR);
+}
+
+/*
+Placement des formes ajoutées au clavier (touches o et n) : translation et rotation cumulées comme avec glTranslatef()
+et glRotatef(), mais appliquées aux points des formes quand elles sont créées. La matrice modelview reste l'identité :
+seule la caméra déplace la vue, et le dessin, l'index spatial et le journal voient les coordonnées finales.
+*/
+typedef struct Placement {
+	float x, y;
+	float angle; // en degrés
+} Placement;
+
+static Placement placement = {0, 0, 0};
+
+/* Comme glTranslatef() : la translation suit l'orientation courante */
+void translatePlacement(float x, float y) {
+	float rad = placement.angle * M_PI / 180.;
+	placement.x += x * cos(rad) - y * sin(rad);
+	placement.y += x * sin(rad) + y * cos(rad);
+}
+
+void rotatePlacement(float angle) {
+	placement.angle += angle;
+}
+
+/* Ajoute le point (x, y) de la forme, placé par la translation et la rotation courantes */
+int addPlacedPoint(PrimitiveList* list, float x, float y, unsigned char r, unsigned char g, unsigned char b) {
+	float rad = placement.angle * M_PI / 180.;
+	return addPoint(list, placement.x + x * cos(rad) - y * sin(rad), placement.y + x * sin(rad) + y * cos(rad), r, g, b);
+}
+
+void drawCircle(PrimitiveList * primitive, Arena* arena){
 	/*int i i;
 	glBegin(GL_LINE_LOOP);
 	float delta = 2 * M_PI / (float) NB_SEGMENTS;
@@ -173,116 +505,760 @@ void drawCircle(PrimitiveList * primitive){
 		glVertex2f(x,y);
 	}
 	glEnd();*/
-	addPrimitive(allocPrimitive(GL_LINE_LOOP),primitive);
+    /*
+    Quatre quarts de cercle en courbes de Bézier cubiques : 13 points de contrôle au lieu de NB_SEGMENTS sommets,
+    découpés à la taille des pixels au moment du dessin. Les points intérieurs de chaque quart sont sur les tangentes,
+    à CIRCLE_KAPPA des extrémités.
+    */
+	if (!newPrimitive(primitive, arena, PRIMITIVE_CUBIC_BEZIER)) {
+		return;
+	}
 	int i;
-	float delta = 2 * M_PI / (float) NB_SEGMENTS;
-
-	for(i=0; i<100; i++){
-		float x = cos(i * delta);
-		float y = sin(i * delta);
-		addPointToList(allocPoint(x,y,255,68,0),&((*primitive)->points));
 
+	reservePoints(&primitive->tail->points, 13);
+	addPlacedPoint(primitive,1,0,255,68,0);
+	for(i=0; i<4; i++){
+		float a0 = i * M_PI / 2;
+		float a1 = (i + 1) * M_PI / 2;
+		addPlacedPoint(primitive,cos(a0) - CIRCLE_KAPPA * sin(a0),sin(a0) + CIRCLE_KAPPA * cos(a0),255,68,0);
+		addPlacedPoint(primitive,cos(a1) + CIRCLE_KAPPA * sin(a1),sin(a1) - CIRCLE_KAPPA * cos(a1),255,68,0);
+		addPlacedPoint(primitive,cos(a1),sin(a1),255,68,0);
 	}
-	addPrimitive(allocPrimitive(GL_POINTS),primitive);
+	newPrimitive(primitive, arena, GL_POINTS);
 }
 
-void drawCarre(PrimitiveList* primitive, float x, float y,float largeur, float longueur, int r, int v, int b){
-	addPrimitive(allocPrimitive(GL_QUADS),primitive);
+void drawCarre(PrimitiveList* primitive, Arena* arena, float x, float y,float largeur, float longueur, int r, int v, int b){
+	if (!newPrimitive(primitive, arena, GL_QUADS)) {
+		return;
+	}
 	float x2 = x + longueur;
 	float y2 = y + largeur;
-	addPointToList(allocPoint(x,y,r,v,b),&((*primitive)->points));
-	addPointToList(allocPoint(x2,y,r,v,b),&((*primitive)->points));
-	addPointToList(allocPoint(x2,y2,r,v,b),&((*primitive)->points));
-	addPointToList(allocPoint(x,y2,r,v,b),&((*primitive)->points));
+	addPlacedPoint(primitive,x,y,r,v,b);
+	addPlacedPoint(primitive,x2,y,r,v,b);
+	addPlacedPoint(primitive,x2,y2,r,v,b);
+	addPlacedPoint(primitive,x,y2,r,v,b);
+}
+
+/*
+Saisie à main levée (bouton gauche) : chaque trait est une GL_LINE_STRIP. Les positions de la souris passent par trois
+étapes avant d'être enregistrées :
+- lissage : moyenne exponentielle des positions, qui gomme le tremblement de la main et les marches des pixels ;
+- distance : une position à moins de STROKE_MIN_DISTANCE pixels de la précédente est ignorée ;
+- direction : tant que le trait reste dans une bande de STROKE_TOLERANCE pixels autour de la direction prise depuis le
+  dernier point enregistré, seule la position la plus récente est gardée, en attente. Elle n'est enregistrée que quand
+  le trait tourne ou se termine.
+Les lignes droites et les courbes lentes ne coûtent ainsi que quelques points, pour un écart au geste inférieur au
+pixel. Le segment en attente est dessiné à part (drawStrokePreview) pour que le trait suive la souris.
+*/
+#define STROKE_MIN_DISTANCE 2.f // en pixels
+#define STROKE_TOLERANCE 0.75f // en pixels
+#define STROKE_SMOOTHING 0.5f // poids de la nouvelle position dans la position lissée, 1 pour ne pas lisser
+
+typedef struct StrokeCapture {
+	int active; // un trait est en cours
+	float smoothX, smoothY; // position lissée, en pixels
+	float lastX, lastY; // dernier point enregistré
+	float dirX, dirY; // direction unitaire du dernier point enregistré vers le premier point en attente
+	int pending; // un point attend de savoir si le trait continue tout droit
+	float pendingX, pendingY;
+	unsigned int stored; // points enregistrés pour le trait en cours
+	unsigned char r, g, b;
+} StrokeCapture;
+
+void initStrokeCapture(StrokeCapture* stroke, unsigned char r, unsigned char g, unsigned char b) {
+	assert(stroke);
+	memset(stroke, 0, sizeof(StrokeCapture));
+	stroke->r = r;
+	stroke->g = g;
+	stroke->b = b;
+}
+
+/* Enregistre un point donné en pixels de la fenêtre dans la primitive de queue */
+void storeStrokePoint(StrokeCapture* stroke, PrimitiveList* list, float px, float py) {
+	float x, y;
+	if (windowToPlane(px, py, &x, &y) && addPoint(list, x, y, stroke->r, stroke->g, stroke->b)) {
+		stroke->stored++;
+	}
+	stroke->lastX = px;
+	stroke->lastY = py;
+}
+
+void beginStroke(StrokeCapture* stroke, PrimitiveList* list, Arena* arena, int px, int py) {
+	assert(stroke);
+	if (!newPrimitive(list, arena, GL_LINE_STRIP)) {
+		return;
+	}
+	stroke->active = 1;
+	stroke->pending = 0;
+	stroke->stored = 0;
+	stroke->smoothX = px;
+	stroke->smoothY = py;
+	storeStrokePoint(stroke, list, px, py);
+}
+
+/* Nouvelle position de la souris pendant un trait. Renvoie 1 si ce qui est affiché a changé. */
+int strokeMotion(StrokeCapture* stroke, PrimitiveList* list, int px, int py) {
+	assert(stroke);
+	if (!stroke->active) {
+		return 0;
+	}
+	stroke->smoothX += STROKE_SMOOTHING * (px - stroke->smoothX);
+	stroke->smoothY += STROKE_SMOOTHING * (py - stroke->smoothY);
+	float x = stroke->smoothX;
+	float y = stroke->smoothY;
+
+	float previousX = stroke->pending ? stroke->pendingX : stroke->lastX;
+	float previousY = stroke->pending ? stroke->pendingY : stroke->lastY;
+	if ((x - previousX) * (x - previousX) + (y - previousY) * (y - previousY) < STROKE_MIN_DISTANCE * STROKE_MIN_DISTANCE) {
+		return 0;
+	}
+
+	if (stroke->pending) {
+        /* Écart à la droite partie du dernier point enregistré, et avancée le long de cette droite */
+		float dx = x - stroke->lastX;
+		float dy = y - stroke->lastY;
+		float across = dx * stroke->dirY - dy * stroke->dirX;
+		float along = dx * stroke->dirX + dy * stroke->dirY;
+		if (fabsf(across) > STROKE_TOLERANCE || along <= 0) {
+            /* Le trait tourne : le point en attente est enregistré et une nouvelle direction commence */
+			storeStrokePoint(stroke, list, stroke->pendingX, stroke->pendingY);
+			stroke->pending = 0;
+		}
+	}
+	if (!stroke->pending) {
+		float dx = x - stroke->lastX;
+		float dy = y - stroke->lastY;
+		float length = sqrtf(dx * dx + dy * dy);
+		stroke->dirX = dx / length;
+		stroke->dirY = dy / length;
+		stroke->pending = 1;
+	}
+	stroke->pendingX = x;
+	stroke->pendingY = y;
+	return 1;
+}
+
+/* Fin du trait : la dernière position, non lissée, est enregistrée pour que le trait s'arrête sous la souris */
+void endStroke(StrokeCapture* stroke, PrimitiveList* list, int px, int py) {
+	assert(stroke);
+	if (!stroke->active) {
+		return;
+	}
+	stroke->smoothX = px;
+	stroke->smoothY = py;
+	if (stroke->pending) {
+		float dx = px - stroke->lastX;
+		float dy = py - stroke->lastY;
+		if (fabsf(dx * stroke->dirY - dy * stroke->dirX) > STROKE_TOLERANCE) {
+			storeStrokePoint(stroke, list, stroke->pendingX, stroke->pendingY);
+		}
+	}
+	if (stroke->stored < 2 || px != stroke->lastX || py != stroke->lastY) {
+		storeStrokePoint(stroke, list, px, py);
+	}
+	stroke->pending = 0;
+	stroke->active = 0;
+}
+
+/* Segment entre le dernier point enregistré et le point en attente */
+void drawStrokePreview(const StrokeCapture* stroke) {
+	float x0, y0, x1, y1;
+	if (!stroke->active || !stroke->pending) {
+		return;
+	}
+	if (!windowToPlane(stroke->lastX, stroke->lastY, &x0, &y0) || !windowToPlane(stroke->pendingX, stroke->pendingY, &x1, &y1)) {
+		return;
+	}
+	glColor3ub(stroke->r, stroke->g, stroke->b);
+	glBegin(GL_LINES);
+	glVertex2f(x0, y0);
+	glVertex2f(x1, y1);
+	glEnd();
+}
+
+/*
+Fichier de dessin : un en-tête, la table des primitives (type OpenGL et plage de sommets), puis tous les sommets à la
+suite, entrelacés au format des VBO (position en float, couleur sur un octet par composante). Les entiers et les
+flottants sont écrits dans l'ordre des octets de la machine.
+Au chargement, le fichier est projeté en mémoire avec mmap() et les primitives pointent directement dans cette
+projection : ni analyse point par point ni allocation, les sommets sont envoyés au GPU tels quels.
+*/
+#define DRAWING_MAGIC "IMCD"
+#define DRAWING_VERSION 2
+
+typedef struct DrawingHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t nbPrimitives;
+	uint32_t nbVertices;
+} DrawingHeader;
+
+typedef struct DrawingEntry {
+	uint32_t primitiveType;
+	uint32_t first; // indice du premier sommet dans le tableau de sommets
+	uint32_t count;
+	float minX, minY, maxX, maxY; // boîte englobante des sommets, pour l'index spatial
+} DrawingEntry;
+
+/* Projection d'un fichier de dessin, à garder tant que les primitives chargées existent */
+typedef struct DrawingFile {
+	void* data;
+	size_t size;
+} DrawingFile;
+
+static const char* drawingPath = "dessin.imcd"; // fichier lu et écrit par les touches l et s
+static int openAtStart = 0; // --open : le dessin est chargé au démarrage
+
+int writeDrawingVertices(FILE* file, const Primitive* primitive) {
+	Vertex buffer[1024];
+	unsigned int i, n = 0;
+	const PointArray* points = &primitive->points;
+	if (primitive->fileVertices) {
+		return fwrite(primitive->fileVertices, sizeof(Vertex), primitive->fileCount, file) == primitive->fileCount;
+	}
+	for (i = 0; i < points->count; ++i) {
+		buffer[n++] = makeVertex(points->x[i], points->y[i], points->rgb[3 * i], points->rgb[3 * i + 1], points->rgb[3 * i + 2]);
+		if (n == sizeof(buffer) / sizeof(buffer[0]) || i + 1 == points->count) {
+			if (fwrite(buffer, sizeof(Vertex), n, file) != n) {
+				return 0;
+			}
+			n = 0;
+		}
+	}
+	return 1;
+}
+
+/* Écrit le dessin dans un fichier temporaire renommé à la fin : un fichier existant n'est jamais laissé à moitié écrit */
+int saveDrawing(const char* filename, const PrimitiveList* list) {
+	assert(filename);
+	assert(list);
+	char tmpname[512];
+	const Primitive* primitive;
+	DrawingHeader header;
+	int ok = 1;
+
+	snprintf(tmpname, sizeof(tmpname), "%s.tmp", filename);
+	FILE* file = fopen(tmpname, "wb");
+	if (!file) {
+		return 0;
+	}
+
+	memcpy(header.magic, DRAWING_MAGIC, 4);
+	header.version = DRAWING_VERSION;
+	header.nbPrimitives = list->count;
+	header.nbVertices = 0;
+	for (primitive = list->head; primitive; primitive = primitive->next) {
+		header.nbVertices += primitiveVertexCount(primitive);
+	}
+	ok = fwrite(&header, sizeof(header), 1, file) == 1;
+
+	uint32_t first = 0;
+	for (primitive = list->head; ok && primitive; primitive = primitive->next) {
+		DrawingEntry entry;
+		entry.primitiveType = primitive->primitiveType;
+		entry.first = first;
+		entry.count = primitiveVertexCount(primitive);
+		entry.minX = primitive->bounds.minX;
+		entry.minY = primitive->bounds.minY;
+		entry.maxX = primitive->bounds.maxX;
+		entry.maxY = primitive->bounds.maxY;
+		ok = fwrite(&entry, sizeof(entry), 1, file) == 1;
+		first += entry.count;
+	}
+	for (primitive = list->head; ok && primitive; primitive = primitive->next) {
+		ok = writeDrawingVertices(file, primitive);
+	}
+
+	if (fclose(file) != 0 || !ok) {
+		remove(tmpname);
+		return 0;
+	}
+	return rename(tmpname, filename) == 0;
+}
+
+void closeDrawing(DrawingFile* drawingFile) {
+	assert(drawingFile);
+	if (drawingFile->data) {
+		munmap(drawingFile->data, drawingFile->size);
+		drawingFile->data = NULL;
+		drawingFile->size = 0;
+	}
+}
+
+/* Vérifie l'en-tête et la table : aucune plage de sommets ne doit sortir du fichier */
+int checkDrawing(const void* data, size_t size) {
+	const DrawingHeader* header = (const DrawingHeader*) data;
+	unsigned int i;
+	if (size < sizeof(DrawingHeader) || memcmp(header->magic, DRAWING_MAGIC, 4) || header->version != DRAWING_VERSION) {
+		return 0;
+	}
+	if (size != sizeof(DrawingHeader) + (size_t) header->nbPrimitives * sizeof(DrawingEntry)
+			+ (size_t) header->nbVertices * sizeof(Vertex)) {
+		return 0;
+	}
+	const DrawingEntry* entries = (const DrawingEntry*) (header + 1);
+	for (i = 0; i < header->nbPrimitives; ++i) {
+		if (entries[i].first > header->nbVertices || entries[i].count > header->nbVertices - entries[i].first
+				|| (entries[i].primitiveType > GL_POLYGON && !isCurveType(entries[i].primitiveType))) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/*
+Remplace le dessin courant par celui du fichier. Le nouveau dessin est construit dans une arène à part et ne remplace le
+dessin courant qu'une fois entièrement alloué : en cas d'échec, le dessin courant est conservé.
+*/
+int loadDrawing(const char* filename, DrawingFile* drawingFile, PrimitiveList* list, Arena* arena) {
+	assert(filename);
+	assert(drawingFile);
+	assert(list);
+	assert(arena);
+	struct stat status;
+	unsigned int i;
+
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		return 0;
+	}
+	if (fstat(fd, &status) != 0 || status.st_size <= 0) {
+		close(fd);
+		return 0;
+	}
+	size_t size = status.st_size;
+	void* data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		return 0;
+	}
+	if (!checkDrawing(data, size)) {
+		munmap(data, size);
+		return 0;
+	}
+    /* Les sommets seront lus en entier lors de l'envoi au GPU */
+	madvise(data, size, MADV_WILLNEED);
+
+	Arena loadedArena;
+	PrimitiveList loaded;
+	initArena(&loadedArena);
+	initPrimitiveList(&loaded);
+	const DrawingHeader* header = (const DrawingHeader*) data;
+	const DrawingEntry* entries = (const DrawingEntry*) (header + 1);
+	const Vertex* vertices = (const Vertex*) (entries + header->nbPrimitives);
+	for (i = 0; i < header->nbPrimitives; ++i) {
+		Primitive* primitive = allocPrimitive(&loadedArena, entries[i].primitiveType);
+		if (!primitive) {
+			clearArena(&loadedArena);
+			munmap(data, size);
+			return 0;
+		}
+		primitive->fileVertices = vertices + entries[i].first;
+		primitive->fileCount = entries[i].count;
+		primitive->bounds.minX = entries[i].minX;
+		primitive->bounds.minY = entries[i].minY;
+		primitive->bounds.maxX = entries[i].maxX;
+		primitive->bounds.maxY = entries[i].maxY;
+		addPrimitive(primitive, &loaded);
+	}
+
+	discardDrawing(list, arena);
+	closeDrawing(drawingFile);
+	drawingFile->data = data;
+	drawingFile->size = size;
+    /* L'arène du dessin, vidée, reprend les blocs du dessin chargé */
+	*arena = loadedArena;
+	*list = loaded;
+	Primitive* primitive;
+	for (primitive = list->head; primitive; primitive = primitive->next) {
+		primitive->points.arena = arena;
+	}
+	return 1;
+}
+
+/* Remplace le dessin par celui du fichier, puis ajoute une primitive vide qui reçoit les points suivants. Un chargement
+   ne s'annule pas : l'historique repart du dessin chargé. */
+int replaceDrawing(const char* filename, DrawingFile* drawingFile, PrimitiveList* list, Arena* arena) {
+	if (!loadDrawing(filename, drawingFile, list, arena)) {
+		return 0;
+	}
+	newPrimitive(list, arena, GL_POINTS);
+	resetHistory(list);
+	return 1;
+}
+
+int copyFile(const char* from, const char* to) {
+	char buffer[64 * 1024];
+	size_t n;
+	int ok = 1;
+	FILE* in = fopen(from, "rb");
+	if (!in) {
+		return 0;
+	}
+	FILE* out = fopen(to, "wb");
+	if (!out) {
+		fclose(in);
+		return 0;
+	}
+	while (ok && (n = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+		ok = fwrite(buffer, 1, n, out) == n;
+	}
+	ok = !ferror(in) && ok;
+	fclose(in);
+	if (fclose(out) != 0 || !ok) {
+		remove(to);
+		return 0;
+	}
+	return 1;
+}
+
+/*
+Le journal repart du dessin qui vient d'être chargé : il est vidé, le fichier est lié sous journal->snapshot (ou copié
+si le lien est impossible), puis un seul évènement de chargement est écrit. Les enregistrements remplacent le fichier de
+dessin par renommage, le lien garde donc le contenu chargé. En cas d'échec, le journal est désactivé.
+*/
+int resetJournal(Journal* journal, const char* drawingFilename) {
+	if (!journal->file) {
+		return 1;
+	}
+	journal->file = freopen(journal->filename, "wb", journal->file);
+	if (journal->file) {
+		setvbuf(journal->file, NULL, _IOFBF, JOURNAL_BUFFER_SIZE);
+		journal->hasColor = 0;
+		remove(journal->snapshot);
+		if (link(drawingFilename, journal->snapshot) == 0 || copyFile(drawingFilename, journal->snapshot)) {
+			journalEvent(journal, JOURNAL_LOAD);
+			flushJournal(journal);
+			return 1;
+		}
+	}
+	closeJournal(journal);
+	return 0;
 }
 
+/* Charge drawingPath à la place du dessin courant */
+int openDrawing(DrawingFile* drawingFile, PrimitiveList* list, Arena* arena) {
+	long long start = getTimeNanoseconds();
+	if (!replaceDrawing(drawingPath, drawingFile, list, arena)) {
+		fprintf(stderr, "Impossible de charger %s\n", drawingPath);
+		return 0;
+	}
+	printf("%s chargé : %u primitives en %.3f ms\n", drawingPath, list->count, (getTimeNanoseconds() - start) / 1e6);
+	if (!resetJournal(&journal, drawingPath)) {
+		fprintf(stderr, "Impossible de lier %s au journal, journal désactivé\n", drawingPath);
+	}
+	return 1;
+}
+
+/*
+Reconstruit le dessin à partir du journal, en repassant par l'historique pour que les annulations et rétablissements
+rejoués retrouvent les mêmes étapes. Seuls les évènements qui suivent le dernier chargement comptent, ou le dernier
+effacement si aucune annulation ne le suit (l'effacement a pu être annulé). Les points consécutifs d'une primitive sont
+comptés d'abord, puis copiés en une fois dans des tableaux réservés à la bonne taille. Le journal doit être fermé
+pendant la relecture. Renvoie le nombre d'évènements rejoués, -1 en cas d'erreur.
+*/
+long replayJournal(const char* filename, DrawingFile* drawingFile, PrimitiveList* list, Arena* arena) {
+	assert(filename);
+	assert(drawingFile);
+	assert(list);
+	assert(arena);
+	struct stat status;
+	size_t i, j;
+	char snapshot[sizeof(journal.snapshot)];
+	snprintf(snapshot, sizeof(snapshot), "%s%s", filename, JOURNAL_SNAPSHOT);
+
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		return -1;
+	}
+	if (fstat(fd, &status) != 0) {
+		close(fd);
+		return -1;
+	}
+	size_t n = status.st_size / sizeof(JournalEvent);
+	if (n == 0) {
+		close(fd);
+		return 0;
+	}
+	void* data = mmap(NULL, n * sizeof(JournalEvent), PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		return -1;
+	}
+	const JournalEvent* events = (const JournalEvent*) data;
+
+	size_t start = n;
+	int undone = 0;
+	while (start > 0 && events[start - 1].type != JOURNAL_LOAD && (events[start - 1].type != JOURNAL_CLEAR || undone)) {
+		undone |= events[start - 1].type == JOURNAL_UNDO;
+		--start;
+	}
+	if (start > 0 && events[start - 1].type == JOURNAL_LOAD) {
+		--start;
+	}
+
+	discardDrawing(list, arena);
+	unsigned char r = 255, g = 255, b = 255;
+	for (i = start; i < n; i = j) {
+		j = i + 1;
+		if (events[i].type == JOURNAL_PRIMITIVE) {
+			if (!newPrimitive(list, arena, events[i].data.primitiveType)) {
+				break;
+			}
+		} else if (events[i].type == JOURNAL_COLOR) {
+			r = events[i].r;
+			g = events[i].g;
+			b = events[i].b;
+		} else if (events[i].type == JOURNAL_CLEAR) {
+			clearDrawing(list);
+		} else if (events[i].type == JOURNAL_LOAD) {
+			if (!replaceDrawing(snapshot, drawingFile, list, arena)) {
+				fprintf(stderr, "Impossible de charger %s\n", snapshot);
+				break;
+			}
+		} else if (events[i].type == JOURNAL_STEP) {
+			commitHistory(list);
+		} else if (events[i].type == JOURNAL_UNDO) {
+			undo(list);
+		} else if (events[i].type == JOURNAL_REDO) {
+			redo(list);
+		} else if (events[i].type == JOURNAL_POINT) {
+			if (!list->tail && !newPrimitive(list, arena, GL_POINTS)) {
+				break;
+			}
+			Primitive* current = list->tail;
+			beginEdit();
+			unsigned int count = 0;
+			for (j = i; j < n && (events[j].type == JOURNAL_POINT || events[j].type == JOURNAL_COLOR); ++j) {
+				count += events[j].type == JOURNAL_POINT;
+			}
+			PointArray* points = &current->points;
+			if (!reservePoints(points, points->count + count)) {
+				break;
+			}
+			for (; i < j; ++i) {
+				if (events[i].type == JOURNAL_COLOR) {
+					r = events[i].r;
+					g = events[i].g;
+					b = events[i].b;
+					continue;
+				}
+				unsigned int k = points->count++;
+				points->x[k] = events[i].data.point.x;
+				points->y[k] = events[i].data.point.y;
+				points->rgb[3 * k] = r;
+				points->rgb[3 * k + 1] = g;
+				points->rgb[3 * k + 2] = b;
+				extendPrimitiveBounds(current, k);
+			}
+			points->dirty = 1;
+		}
+	}
+	munmap(data, n * sizeof(JournalEvent));
+	return (long) (n - start);
+}
+
+/* Étapes d'une image mesurées par le profileur */
+typedef enum FrameStage {
+	STAGE_LANDMARKS,
+	STAGE_PRIMITIVES, // dessin ou palette
+	STAGE_OVERLAY,
+	STAGE_EVENTS,
+	STAGE_SWAP,
+	STAGE_SLEEP,
+	NB_STAGES
+} FrameStage;
+
+static const char* STAGE_NAMES[NB_STAGES] = {"landmarks", "primitives", "overlay", "events", "swap", "sleep"};
+static const unsigned char STAGE_COLORS[3 * NB_STAGES] = {
+	0, 160, 255,
+	255, 200, 0,
+	160, 160, 160,
+	255, 0, 255,
+	255, 60, 60,
+	40, 120, 40
+};
+
+/* Options communes (voir parseCommonArgument()), --open <fichier de dessin> et --journal <fichier journal> */
+void parseArguments(int argc, char** argv) {
+	int i;
+	for (i = 1; i < argc; ++i) {
+		if (parseCommonArgument(argc, argv, &i)) {
+			continue;
+		} else if (!strcmp(argv[i], "--open") && i + 1 < argc) {
+			drawingPath = argv[++i];
+			openAtStart = 1;
+		} else if (!strcmp(argv[i], "--journal") && i + 1 < argc) {
+			journalPath = argv[++i];
+		} else {
+			fprintf(stderr, "Option inconnue : %s\n", argv[i]);
+		}
+	}
+}
+
+/* Vue par défaut : [-1, 1] x [-1, 1], le repère dans lequel les formes et les graduations sont placées */
+static Camera camera = {0, 0, 1, 1, 1};
+
+/* Le contexte a pu être recréé par SDL_SetVideoMode() : viewport et projection sont posés après */
 void resizeViewport() {
+	if (!headless) {
+		SDL_SetVideoMode(WINDOW_WIDTH, WINDOW_HEIGHT, BIT_PER_PIXEL, SDL_OPENGL | SDL_RESIZABLE);
+	}
+	checkContext();
 	glViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
-    //glMatrixMode(GL_PROJECTION);
-	glMatrixMode(GL_MODELVIEW);
-	glLoadIdentity();
-	gluOrtho2D(-15., 15., -15., 15.);
-	SDL_SetVideoMode(WINDOW_WIDTH, WINDOW_HEIGHT, BIT_PER_PIXEL, SDL_OPENGL | SDL_RESIZABLE);
-}
-
-
-static const unsigned char COLORS[] = {
-	255, 255, 255,
-	0, 0, 0,
-	255, 0, 0,
-	0, 255, 0,
-	0, 0, 255,
-	255, 255, 0,
-	0, 255, 255,
-	255, 0, 255
-};
+	applyCamera(&camera);
+	buildLandmarks(-1, 1, -1, 1, LANDMARK_SPACING, LANDMARK_TICK_SIZE);
+}
 
-static const unsigned int NB_COLORS = sizeof(COLORS) / (3 * sizeof(unsigned char));
+/* Génération du contexte OpenGL dans laquelle les VBO des primitives ont été créés */
+static unsigned int resourcesGeneration = 0;
 
-void drawColorPalette() {
-	int i;
-    float dx = 2.f / NB_COLORS; // dx = "delta x"
-    glBegin(GL_QUADS);
-    for(i = 0; i < NB_COLORS; ++i) {
-    	glColor3ubv(COLORS + i * 3);
-    	glVertex2f(-1 + i * dx, -1);
-    	glVertex2f(-1 + (i + 1) * dx, -1);
-    	glVertex2f(-1 + (i + 1) * dx, 1);
-    	glVertex2f(-1 + i  * dx, 1);
-    }
-    glEnd();
+/* Après un changement de contexte (voir checkContext()), les VBO de toutes les primitives, historique compris, sont
+   refaits au prochain dessin. Le repère est refait par resizeViewport(). */
+void checkGLResources() {
+	unsigned int i;
+	if (resourcesGeneration == contextGeneration) {
+		return;
+	}
+	resourcesGeneration = contextGeneration;
+	glClearColor(0.1, 0.1, 0.1, 1.0); // un nouveau contexte repart de l'état par défaut
+	for (i = 0; i < history.nbCreated; ++i) {
+		forgetPrimitiveBuffers(history.created[i]);
+	}
 }
 
+
+/* Délai maximal d'attente d'un évènement quand la scène n'a pas changé */
+static const Uint32 IDLE_TIMEOUT_MILLISECONDS = 500;
+
 int main(int argc, char** argv) {
 
-    /* Initialisation de la SDL */
-	if(-1 == SDL_Init(SDL_INIT_VIDEO)) {
+	initProfiler(STAGE_NAMES, STAGE_COLORS, NB_STAGES);
+	parseArguments(argc, argv);
+
+    /* Initialisation de la SDL (sans la vidéo en mode sans fenêtre) */
+	if(-1 == SDL_Init((headless ? 0 : SDL_INIT_VIDEO) | SDL_INIT_TIMER)) {
 		fprintf(stderr, "Impossible d'initialiser la SDL. Fin du programme.\n");
 		return EXIT_FAILURE;
 	}
 
-    /* Ouverture d'une fenêtre et création d'un contexte OpenGL */
-	if(NULL == SDL_SetVideoMode(WINDOW_WIDTH, WINDOW_HEIGHT, BIT_PER_PIXEL, SDL_OPENGL | SDL_RESIZABLE)) {
-		fprintf(stderr, "Impossible d'ouvrir la fenetre. Fin du programme.\n");
-		return EXIT_FAILURE;
+	if (headless) {
+        /* Création d'un contexte OpenGL hors écran */
+		if (!createHeadlessContext(WINDOW_WIDTH, WINDOW_HEIGHT)) {
+			fprintf(stderr, "Impossible de créer le contexte hors écran. Fin du programme.\n");
+			SDL_Quit();
+			return EXIT_FAILURE;
+		}
+	} else {
+        /* Ouverture d'une fenêtre et création d'un contexte OpenGL */
+		SDL_GL_SetAttribute(SDL_GL_SWAP_CONTROL, vsync);
+		if(NULL == SDL_SetVideoMode(WINDOW_WIDTH, WINDOW_HEIGHT, BIT_PER_PIXEL, SDL_OPENGL | SDL_RESIZABLE)) {
+			fprintf(stderr, "Impossible d'ouvrir la fenetre. Fin du programme.\n");
+			return EXIT_FAILURE;
+		}
+		SDL_WM_SetCaption("Paint IMAC", NULL);
 	}
-	SDL_WM_SetCaption("Paint IMAC", NULL);
 
+	resizeViewport();
 	glClearColor(0.1, 0.1, 0.1, 1.0);
 	glClear(GL_COLOR_BUFFER_BIT);
 
+    /* Toute la mémoire du dessin est prise dans cette arène */
+	Arena drawing;
+	initArena(&drawing);
+
     /* On créé une première primitive par défaut */
-	PrimitiveList primitives = allocPrimitive(GL_LINE_STRIP);
+	PrimitiveList primitives;
+	initPrimitiveList(&primitives);
+	initSpatialGrid(&drawingGrid, DRAWING_CELL_SIZE);
+
+    /* Dessin enregistré : ses sommets restent dans le fichier projeté en mémoire */
+	DrawingFile drawingFile = {NULL, 0};
+
+    /* Journal : le dessin qu'il contient est rejoué avant que les nouvelles modifications y soient ajoutées */
+	long replayed = 0;
+	if (journalPath) {
+		long long start = getTimeNanoseconds();
+		replayed = replayJournal(journalPath, &drawingFile, &primitives, &drawing);
+		if (replayed > 0) {
+			printf("%s rejoué : %ld évènements, %u primitives en %.3f ms\n", journalPath, replayed, primitives.count,
+				(getTimeNanoseconds() - start) / 1e6);
+		}
+		if (!openJournal(&journal, journalPath)) {
+			fprintf(stderr, "Impossible d'ouvrir le journal %s\n", journalPath);
+		}
+	}
+	if (!primitives.count) {
+		newPrimitive(&primitives, &drawing, GL_LINE_STRIP);
+	}
+    /* L'historique reconstruit par le rejeu est gardé : on peut annuler ce qui a été fait avant l'arrêt */
+	if (replayed <= 0) {
+		resetHistory(&primitives);
+	}
+
+	if (openAtStart) {
+		openDrawing(&drawingFile, &primitives, &drawing);
+	}
 
-	int loop = 1;
+    /* Banc d'essai : les scènes synthétiques remplacent la boucle d'affichage */
+	if (benchmark) {
+		runBenchmark("tp2");
+	}
+
+	int loop = !benchmark;
+	FrameScheduler scheduler;
+	initFrameScheduler(&scheduler);
+	StrokeCapture stroke;
+	initStrokeCapture(&stroke, 255, 255, 255);
+    int sceneDirty = 1; // la scène doit être redessinée à la prochaine image
     int mode = 0; // le mode d'affichage. 0 = le dessin, 1 = la palette
    // unsigned int currentColor = 0; // l'index de la couleur courante dans le tableau COLORS
 
     /* Boucle d'affichage */
     while(loop) {
 
-        /* Récupération du temps au début de la boucle */
-    	Uint32 startTime = SDL_GetTicks();
+    	beginProfileFrame();
 
-        /* Code de dessin */
+        /* Code de dessin : uniquement si la scène a changé depuis la dernière image */
+        int redrawn = sceneDirty;
+        if (redrawn) {
 
-        glClear(GL_COLOR_BUFFER_BIT); // Toujours commencer par clear le buffer
+            glClear(GL_COLOR_BUFFER_BIT); // Toujours commencer par clear le buffer
 
-   
-        drawLandmarks();
-        drawLandmark();
 
+            drawLandmarks();
+            endProfileStage(STAGE_LANDMARKS);
 
-        if (mode == 0) {
-            drawPrimitives(primitives); // On dessine la liste de primitives
-        }
-        else if (mode == 1) {
-        	drawColorPalette();
+
+            if (mode == 0) {
+                drawVisiblePrimitives(&primitives, &drawingGrid); // On dessine les primitives visibles
+                drawStrokePreview(&stroke);
+            }
+            else if (mode == 1) {
+            	drawColorPalette();
+            }
+            endProfileStage(STAGE_PRIMITIVES);
+
+            if (profiler.showOverlay) {
+            	drawProfileOverlay();
+            }
+            endProfileStage(STAGE_OVERLAY);
+
+            sceneDirty = 0;
         }
 
         /* Boucle traitant les evenements */
         SDL_Event e;
-        while(SDL_PollEvent(&e)) {
+        int hasEvent = SDL_PollEvent(&e);
+        if (!hasEvent && !redrawn && !sceneDirty && !headless) {
+            /* Rien à redessiner : on bloque jusqu'au prochain évènement plutôt que de tourner à vide */
+            hasEvent = waitEventTimeout(&e, IDLE_TIMEOUT_MILLISECONDS);
+        }
+        for(; hasEvent; hasEvent = SDL_PollEvent(&e)) {
+
+            if (isSceneEvent(&e)) {
+                sceneDirty = 1;
+            }
 
             /* L'utilisateur ferme la fenêtre : */
         	if(e.type == SDL_QUIT) {
@@ -290,15 +1266,43 @@ int main(int argc, char** argv) {
         		break;
         	}
 
-        	if(e.type == SDL_MOUSEBUTTONDOWN){
-        		float x =  e.button.x;
-        		float y =  e.button.y;
-        		printf("x :%f y:%f",x,y);
-        		drawCarre(&primitives,x,y,0.3,0.2,255,255,0);
-        		break;
-        	}/*else{
-        		drawCarre(&primitives,e.button.x,e.button.y,0.3,0.2,255,255,0);
-        	}*/
+        	if(e.type == SDL_MOUSEBUTTONDOWN && handleCameraWheel(&camera, &e.button)){
+        		applyCamera(&camera);
+        		continue;
+        	}
+
+        	if(e.type == SDL_MOUSEBUTTONDOWN && e.button.button == SDL_BUTTON_RIGHT){
+        		/* Clic droit : primitive sous la souris */
+        		float x, y;
+        		if (windowToPlane(e.button.x, e.button.y, &x, &y)) {
+        			/* La tolérance est fixée à l'écran : elle suit le zoom dans le plan */
+        			float tolerance = windowLengthToPlane(PICK_TOLERANCE_PIXELS);
+        			Primitive* picked = pickPrimitive(&primitives, &drawingGrid, x, y, tolerance);
+        			if (picked) {
+        				printf("primitive %u (type %u, %u sommets) en %f %f\n", picked->index, picked->primitiveType,
+        					primitiveVertexCount(picked), x, y);
+        			} else {
+        				printf("aucune primitive en %f %f\n", x, y);
+        			}
+        		}
+        		continue;
+        	}
+
+        	/* Bouton gauche : dessin à main levée */
+        	if(e.type == SDL_MOUSEBUTTONDOWN && e.button.button == SDL_BUTTON_LEFT){
+        		beginStroke(&stroke, &primitives, &drawing, e.button.x, e.button.y);
+        		continue;
+        	}
+        	if(e.type == SDL_MOUSEMOTION){
+        		if (strokeMotion(&stroke, &primitives, e.motion.x, e.motion.y)) {
+        			sceneDirty = 1;
+        		}
+        		continue;
+        	}
+        	if(e.type == SDL_MOUSEBUTTONUP && e.button.button == SDL_BUTTON_LEFT){
+        		endStroke(&stroke, &primitives, e.button.x, e.button.y);
+        		continue;
+        	}
 
             /* Quelques exemples de traitement d'evenements : */
         	switch(e.type) {
@@ -308,10 +1312,18 @@ int main(int argc, char** argv) {
 
         		printf("touche pressée (code = %d)\n", e.key.keysym.sym);
 
+        		/* Les touches peuvent changer la primitive de queue : le trait en cours s'arrête là */
+        		endStroke(&stroke, &primitives, (int) stroke.smoothX, (int) stroke.smoothY);
+
         		if (e.key.keysym.sym == SDLK_SPACE) {
         			mode = 1;
         		}
 
+        		if (handleCameraKey(&camera, e.key.keysym.sym)) {
+        			applyCamera(&camera);
+        			break;
+        		}
+
         		switch(e.key.keysym.sym) {
 
         			case SDLK_q:
@@ -322,9 +1334,13 @@ int main(int argc, char** argv) {
         			mode = 1;
         			break;
 
+        			case SDLK_f:
+        			profiler.showOverlay = !profiler.showOverlay;
+        			break;
+
         			case SDLK_o:
-        			glTranslatef(0.2,0.1,0);
-        			drawCircle(&primitives);
+        			translatePlacement(0.2,0.1);
+        			drawCircle(&primitives, &drawing);
         			break;
 
         			case SDLK_m:
@@ -333,36 +1349,41 @@ int main(int argc, char** argv) {
         			break;
 
         			case SDLK_n:
-        			glTranslatef(0.2,0,0);
-        			glRotatef(-45,0.0,0.0,1.0);
-        			drawCarre(&primitives,0.2,0.7,0.3,0.2,200,200,200);
+        			translatePlacement(0.2,0);
+        			rotatePlacement(-45);
+        			drawCarre(&primitives,&drawing,0.2,0.7,0.3,0.2,200,200,200);
         			break;
 
-        			case SDLK_UP:
-        			glTranslatef(0,0.2,0);
+        			case SDLK_p:
+        			newPrimitive(&primitives, &drawing, GL_POINTS);
         			break;
 
-        			case SDLK_DOWN:
-        			glTranslatef(0,-0.2,0);
+        			case SDLK_s:
+        			if (!saveDrawing(drawingPath, &primitives)) {
+        				fprintf(stderr, "Impossible d'enregistrer %s\n", drawingPath);
+        			}
         			break;
 
-        			case SDLK_LEFT:
-        			glTranslatef(-0.2,0,0);
+        			case SDLK_l:
+        			openDrawing(&drawingFile, &primitives, &drawing);
         			break;
 
-
-        			case SDLK_RIGHT:
-        			glTranslatef(0.2,0,0);
+        			case SDLK_z:
+        			if (undo(&primitives)) {
+        				journalEvent(&journal, JOURNAL_UNDO);
+        			}
         			break;
 
-        			case SDLK_p:
-        			addPrimitive(allocPrimitive(GL_POINTS), &primitives);
+        			case SDLK_y:
+        			if (redo(&primitives)) {
+        				journalEvent(&journal, JOURNAL_REDO);
+        			}
         			break;
 
         			case SDLK_c:
                             /* Touche pour effacer le dessin */
-                            deletePrimitive(&primitives); // on supprime les primitives actuelles
-                            addPrimitive(allocPrimitive(GL_POINTS), &primitives); // on réinitialise à la primitive courante
+                            clearDrawing(&primitives); // on repart d'une liste vide, l'effacement peut être annulé
+                            newPrimitive(&primitives, &drawing, GL_POINTS); // on réinitialise à la primitive courante
                             break;
 
                             default:
@@ -383,25 +1404,66 @@ int main(int argc, char** argv) {
                         WINDOW_WIDTH = e.resize.w;
                         WINDOW_HEIGHT = e.resize.h;
                         resizeViewport();
+                        checkGLResources();
 
                         default:
                         break;
                     }
                 }
 
+                /* Un trait n'est qu'une étape de l'historique, enregistrée quand il se termine */
+                if (!stroke.active && commitHistory(&primitives)) {
+                	journalEvent(&journal, JOURNAL_STEP);
+                }
+                flushJournal(&journal);
+                endProfileStage(STAGE_EVENTS);
+
         /* Echange du front et du back buffer : mise à jour de la fenêtre */
-                SDL_GL_SwapBuffers();
+                if (redrawn) {
+                	swapBuffers();
+                	endProfileStage(STAGE_SWAP);
+                }
+
+        /* La courbe de profilage est mise à jour à chaque image tant qu'elle est affichée */
+                if (profiler.showOverlay) {
+                	sceneDirty = 1;
+                }
+
+        /* Sans fenêtre, on redessine à chaque tour jusqu'au nombre d'images demandé */
+                if (headless) {
+                	sceneDirty = 1;
+                	if (frameNumber >= headlessFrames) {
+                		loop = 0;
+                	}
+                }
 
-        /* Calcul du temps écoulé */
-                Uint32 elapsedTime = SDL_GetTicks() - startTime;
+        /* Pause jusqu'à l'échéance de l'image suivante */
+                if(redrawn && !headless) {
+                	waitNextFrame(&scheduler);
+                }
 
-        /* Si trop peu de temps s'est écoulé, on met en pause le programme */
-                if(elapsedTime < FRAMERATE_MILLISECONDS) {
-                	SDL_Delay(FRAMERATE_MILLISECONDS - elapsedTime);
+        /* Seules les images réellement redessinées sont comptées */
+                if (redrawn) {
+                	endProfileStage(STAGE_SLEEP);
+                	endProfileFrame();
                 }
             }
 
-            deletePrimitive(&primitives);
+            discardDrawing(&primitives, &drawing);
+            deleteHistory();
+            deleteSpatialGrid(&drawingGrid);
+            closeDrawing(&drawingFile);
+            closeJournal(&journal);
+            deleteLandmarks();
+
+            if (profileFile) {
+            	printProfileSummary(stdout);
+            	if (!writeProfileCSV(profileFile)) {
+            		fprintf(stderr, "Impossible d'écrire %s\n", profileFile);
+            	}
+            }
+
+            destroyHeadlessContext();
 
     /* Liberation des ressources associées à la SDL */ 
             SDL_Quit();
@@ -1,67 +1,15 @@
-#include <SDL/SDL.h>
-#include <GL/gl.h>
-#include <GL/glu.h>
+#include "paint.h"
 #include <stdlib.h>
-#include <stdio.h>
+#include <string.h>
 #include <assert.h>
 #include <math.h>
-#include <time.h>
-
+#include <float.h>
 
 #define NB_SEGMENTS 100
-/* Dimensions de la fenêtre */
-static unsigned int WINDOW_WIDTH = 800;
-static unsigned int WINDOW_HEIGHT = 600;
 
 /* Nombre de bits par pixel de la fenêtre */
 static const unsigned int BIT_PER_PIXEL = 32;
 
-/* Nombre minimal de millisecondes separant le rendu de deux images */
-static const Uint32 FRAMERATE_MILLISECONDS = 1000 / 60;
-
-typedef struct Point {
-	float x, y;
-	unsigned char r, g, b;
-	struct Point* next;
-} Point, *PointList;
-
-typedef struct Primitive{
-	GLenum primitiveType;
-	PointList points;
-	struct Primitive* next;
-} Primitive, *PrimitiveList;
-
-
-Point* allocPoint(float x, float y, unsigned char r, unsigned char g, unsigned char b) {
-    /*
-    On alloue un espace mémoire suffisant pour pouvoir stocker un point
-    Attention : la fonction malloc() renvoie un void* qu'il faut impérativement caster en Point*.
-    */
-    Point* point = (Point*) malloc(sizeof(Point));
-    if (!point) {
-    	return NULL;
-    }
-    point->x = x;
-    point->y = y;
-    point->r = r;
-    point->g = g;
-    point->b = b;
-    point->next = NULL;
-    return point;
-}
-
-void addPointToList(Point* point, PointList* list) {
-	assert(point);
-	assert(list);
-	if (*list == NULL) {
-        /* Si le pointeur sur la liste est vide, on le modifie pour le faire pointer sur le point donné en paramètre */
-		*list = point;
-	} else {
-        /* Sinon, on réapplique la même fonction mais sur le point suivant */
-		addPointToList(point, &(*list)->next);
-	}
-}
-
 void rotation(float a){
 	glRotatef(a,0.0,0.0,1.0);
 }
@@ -71,338 +19,1006 @@ void taille(float x, float y, float z){
 }
 
 
-void drawPoints(PointList list) {
-	while(list) {
-		glColor3ub(list->r, list->g, list->b);
-		glVertex2f(list->x, list->y);
-		list = list->next;
-	}
+void drawSquare(){
+	glColor3ub(255,0,0);
+	glBegin(GL_QUADS);
+	glVertex2f(-0.5, 0.5);
+	glVertex2f(0.5,0.5);
+	glVertex2f(0.5,-0.5);
+	glVertex2f(-0.5,-0.5);
+	glEnd();
 }
 
-void deletePoints(PointList* list) {
-	assert(list);
-	while (*list) {
-		Point* next = (*list)->next;
-		free(*list);
-		*list = next;
+
+/* Espacement et taille des graduations du repère */
+static const float LANDMARK_SPACING = 1;
+static const float LANDMARK_TICK_SIZE = 0.05;
+
+
+/* Nombre minimal de segments d'un cercle, quelle que soit sa taille à l'écran */
+#define MIN_SEGMENTS 12
+
+/* Longueur visée, en pixels, d'un segment de cercle à l'écran */
+static const float CIRCLE_SEGMENT_PIXELS = 4.f;
+
+/* Cercles unité précalculés (cos, sin entrelacés), indexés par nombre de segments */
+static GLfloat* circleTables[NB_SEGMENTS + 1];
+
+const GLfloat* getUnitCircle(int segments) {
+	assert(segments >= MIN_SEGMENTS && segments <= NB_SEGMENTS);
+	if (!circleTables[segments]) {
+        /* Premier cercle de cette finesse : seul appel à cos()/sin() pour ce nombre de segments */
+		GLfloat* table = (GLfloat*) malloc(2 * segments * sizeof(GLfloat));
+		if (!table) {
+			return NULL;
+		}
+		int i;
+		double delta = 2 * M_PI / segments;
+		for(i=0; i<segments; i++){
+			table[2 * i] = cos(i * delta);
+			table[2 * i + 1] = sin(i * delta);
+		}
+		circleTables[segments] = table;
 	}
+	return circleTables[segments];
 }
 
-Primitive* allocPrimitive(GLenum primitiveType) {
-    /*
-    On alloue un espace mémoire suffisant pour pouvoir stocker une primitive
-    Attention : la fonction malloc() renvoie un void* qu'il faut impérativement caster en Primitive*.
-    */
-    Primitive* primitive = (Primitive*) malloc(sizeof(Primitive));
-    if (!primitive) {
-    	return NULL;
-    }
-    primitive->primitiveType = primitiveType;
-    primitive->points = NULL;
-    primitive->next = NULL;
-    return primitive;
+void deleteCircleTables() {
+	int i;
+	for(i=0; i<=NB_SEGMENTS; i++){
+		free(circleTables[i]);
+		circleTables[i] = NULL;
+	}
 }
 
-void addPrimitive(Primitive* primitive, PrimitiveList* list) {
-	assert(primitive);
-	assert(list);
-	primitive->next = (*list);
-	(*list) = primitive;
+/* Rayon, en pixels, d'un cercle unité dessiné avec les matrices courantes */
+float unitCircleScreenRadius() {
+	GLfloat m[16], p[16];
+	GLint viewport[4];
+	glGetFloatv(GL_MODELVIEW_MATRIX, m);
+	glGetFloatv(GL_PROJECTION_MATRIX, p);
+	glGetIntegerv(GL_VIEWPORT, viewport);
+
+    /* Image des axes x et y du repère local en coordonnées normalisées, puis en pixels */
+	float xx = (p[0] * m[0] + p[4] * m[1] + p[8] * m[2] + p[12] * m[3]) * viewport[2] / 2;
+	float xy = (p[1] * m[0] + p[5] * m[1] + p[9] * m[2] + p[13] * m[3]) * viewport[3] / 2;
+	float yx = (p[0] * m[4] + p[4] * m[5] + p[8] * m[6] + p[12] * m[7]) * viewport[2] / 2;
+	float yy = (p[1] * m[4] + p[5] * m[5] + p[9] * m[6] + p[13] * m[7]) * viewport[3] / 2;
+	float rx = sqrt(xx * xx + xy * xy);
+	float ry = sqrt(yx * yx + yy * yy);
+	return rx > ry ? rx : ry;
 }
 
-void drawPrimitives(PrimitiveList list) {
-	while(list) {
-		glBegin(list->primitiveType);
-		drawPoints(list->points);
-		glEnd();
-		list = list->next;
+/* Niveau de détail : assez de segments pour que chacun fasse environ CIRCLE_SEGMENT_PIXELS à l'écran */
+int circleSegments(float radiusPixels) {
+	int segments = (int) ceil(2 * M_PI * radiusPixels / CIRCLE_SEGMENT_PIXELS);
+	segments = (segments + 3) & ~3; // multiple de 4 : peu de tables différentes
+	if (segments < MIN_SEGMENTS) {
+		return MIN_SEGMENTS;
 	}
+	if (segments > NB_SEGMENTS) {
+		return NB_SEGMENTS;
+	}
+	return segments;
+}
+
+/* Transformation affine 2D : x' = a*x + c*y + tx, y' = b*x + d*y + ty (équivalent CPU de la modelview) */
+typedef struct Transform2D {
+	float a, b, c, d;
+	float tx, ty;
+} Transform2D;
+
+Transform2D identityTransform() {
+	Transform2D t = {1, 0, 0, 1, 0, 0};
+	return t;
+}
+
+/* Comme glTranslatef() : la translation est appliquée avant la transformation courante */
+void translateTransform(Transform2D* t, float x, float y) {
+	t->tx += t->a * x + t->c * y;
+	t->ty += t->b * x + t->d * y;
+}
+
+void scaleTransform(Transform2D* t, float x, float y) {
+	t->a *= x;
+	t->b *= x;
+	t->c *= y;
+	t->d *= y;
 }
 
-void deletePrimitive(PrimitiveList* list) {
-	assert(list);
-	while(*list) {
-		Primitive* next = (*list)->next;
-		deletePoints(&(*list)->points);
-		free(*list);
-		*list = next;
+void rotateTransform(Transform2D* t, float angle) {
+	float rad = angle * M_PI / 180.;
+	float cs = cos(rad);
+	float sn = sin(rad);
+	Transform2D r = *t;
+	t->a = r.a * cs + r.c * sn;
+	t->b = r.b * cs + r.d * sn;
+	t->c = r.c * cs - r.a * sn;
+	t->d = r.d * cs - r.b * sn;
+}
+
+Transform2D makeTransform(float x, float y, float angle) {
+	Transform2D t = identityTransform();
+	translateTransform(&t, x, y);
+	rotateTransform(&t, angle);
+	return t;
+}
+
+/* Plus grand facteur d'échelle appliqué par la transformation */
+float transformScale(const Transform2D* t) {
+	float sx = sqrt(t->a * t->a + t->b * t->b);
+	float sy = sqrt(t->c * t->c + t->d * t->d);
+	return sx > sy ? sx : sy;
+}
+
+/* Matrice 4x4 (colonnes) à passer à glMultMatrixf() */
+void transformToMatrix(const Transform2D* t, GLfloat* m) {
+	m[0] = t->a;  m[1] = t->b;  m[2] = 0;  m[3] = 0;
+	m[4] = t->c;  m[5] = t->d;  m[6] = 0;  m[7] = 0;
+	m[8] = 0;     m[9] = 0;     m[10] = 1; m[11] = 0;
+	m[12] = t->tx; m[13] = t->ty; m[14] = 0; m[15] = 1;
+}
+
+/* Maillage : liste de triangles colorés, exprimés dans le repère de l'objet et stockés dans un VBO */
+typedef struct Mesh {
+	Vertex* vertices;
+	unsigned int count;
+	unsigned int capacity;
+	GLuint vbo;
+} Mesh;
+
+void initMesh(Mesh* mesh) {
+	assert(mesh);
+	mesh->vertices = NULL;
+	mesh->count = 0;
+	mesh->capacity = 0;
+	mesh->vbo = 0;
+}
+
+int addVertexToMesh(Mesh* mesh, float x, float y, unsigned char r, unsigned char g, unsigned char b) {
+	assert(mesh);
+	if (mesh->count == mesh->capacity) {
+		unsigned int capacity = mesh->capacity ? 2 * mesh->capacity : 64;
+		Vertex* vertices = (Vertex*) realloc(mesh->vertices, capacity * sizeof(Vertex));
+		if (!vertices) {
+			return 0;
+		}
+		mesh->vertices = vertices;
+		mesh->capacity = capacity;
 	}
+	Vertex* v = mesh->vertices + mesh->count++;
+	v->x = x;
+	v->y = y;
+	v->r = r;
+	v->g = g;
+	v->b = b;
+	v->a = 255;
+	return 1;
 }
 
-void drawSquare(){
-	glColor3ub(255,0,0);
-	glBegin(GL_QUADS);
-	glVertex2f(-0.5, 0.5);
-	glVertex2f(0.5,0.5);
-	glVertex2f(0.5,-0.5);
-	glVertex2f(-0.5,-0.5);
-	glEnd();
+void uploadMesh(Mesh* mesh) {
+	assert(mesh);
+	if (!mesh->vbo) {
+		glGenBuffers(1, &mesh->vbo);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, mesh->vbo);
+	glBufferData(GL_ARRAY_BUFFER, mesh->count * sizeof(Vertex), mesh->vertices, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
+void drawMesh(const Mesh* mesh) {
+	glBindBuffer(GL_ARRAY_BUFFER, mesh->vbo);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+	glVertexPointer(2, GL_FLOAT, sizeof(Vertex), (const GLvoid*) 0);
+	glColorPointer(3, GL_UNSIGNED_BYTE, sizeof(Vertex), (const GLvoid*) (2 * sizeof(float)));
+	glDrawArrays(GL_TRIANGLES, 0, mesh->count);
+	glDisableClientState(GL_COLOR_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
 
-void drawLandmarks(){
-	float i;
-	glBegin(GL_LINES);
-	for(i=-4; i<4; i+=1){
-		glColor3ub(255,255,255);
-		glVertex2f(i,-0.05);
-		glVertex2f(i,0.05);
-		glVertex2f(-0.05,i);
-		glVertex2f(0.05,i);
+void deleteMesh(Mesh* mesh) {
+	assert(mesh);
+	if (mesh->vbo) {
+		glDeleteBuffers(1, &mesh->vbo);
 	}
+	free(mesh->vertices);
+	initMesh(mesh);
+}
 
-	glEnd();
+/* Construction d'un maillage avec une pile de matrices CPU, sur le modèle de glPushMatrix()/glTranslatef()/... */
+#define MESH_STACK_DEPTH 16
+
+typedef struct MeshBuilder {
+	Mesh* mesh;
+	Transform2D stack[MESH_STACK_DEPTH];
+	int top;
+	unsigned char r, g, b;
+	float pixelsPerUnit; // taille à l'écran d'une unité du repère de départ, échelle des copies comprise
+	unsigned int segments; // segments de cercle émis, clé du cache des maillages du bras
+} MeshBuilder;
+
+/* scale : plus grande échelle à laquelle les copies du maillage seront dessinées, pour le niveau de détail des cercles */
+void beginMesh(MeshBuilder* builder, Mesh* mesh, float scale) {
+	assert(builder);
+	assert(mesh);
+	builder->mesh = mesh;
+	builder->top = 0;
+	builder->stack[0] = identityTransform();
+	builder->r = builder->g = builder->b = 255;
+	builder->pixelsPerUnit = unitCircleScreenRadius() * scale;
+	builder->segments = 0;
 }
 
-void drawLandmark(){
-	glBegin(GL_LINES);
-	glColor3ub(255,0,0);
-	glVertex2f(-4, 0);
-	glVertex2f(4,0);
-	glColor3ub(0,255,0);
-	glVertex2f(0,-3);
-	glVertex2f(0,3);
-	glEnd();
+void meshPushMatrix(MeshBuilder* builder) {
+	assert(builder->top + 1 < MESH_STACK_DEPTH);
+	builder->stack[builder->top + 1] = builder->stack[builder->top];
+	builder->top++;
+}
+
+void meshPopMatrix(MeshBuilder* builder) {
+	assert(builder->top > 0);
+	builder->top--;
 }
 
+void meshTranslatef(MeshBuilder* builder, float x, float y) {
+	translateTransform(&builder->stack[builder->top], x, y);
+}
+
+void meshScalef(MeshBuilder* builder, float x, float y) {
+	scaleTransform(&builder->stack[builder->top], x, y);
+}
 
-void drawCircle(){
+void meshColor3ub(MeshBuilder* builder, unsigned char r, unsigned char g, unsigned char b) {
+	builder->r = r;
+	builder->g = g;
+	builder->b = b;
+}
+
+void meshVertex(MeshBuilder* builder, float x, float y) {
+	const Transform2D* t = &builder->stack[builder->top];
+	addVertexToMesh(builder->mesh, t->a * x + t->c * y + t->tx, t->b * x + t->d * y + t->ty, builder->r, builder->g, builder->b);
+}
+
+/* Polygone simple (x, y entrelacés), convexe ou non, ajouté en triangles */
+void meshPolygon(MeshBuilder* builder, const GLfloat* points, int count) {
 	int i;
-	glBegin(GL_POLYGON);
-	float delta = 2 * M_PI / (float) NB_SEGMENTS;
-	for(i=0; i<100; i++){
-        glColor3ub(255,255,255);
-		float x = (cos(i * delta));
-		float y = (sin(i * delta));
-		glVertex2f(x,y);
+	unsigned int* triangles = count >= 3 ? (unsigned int*) malloc(3 * (count - 2) * sizeof(unsigned int)) : NULL;
+	if (!triangles) {
+		return;
 	}
-	glEnd();
+	int n = triangulatePolygon(points, count, triangles);
+	for(i=0; i<n; i++){
+		meshVertex(builder, points[2 * triangles[i]], points[2 * triangles[i] + 1]);
+	}
+	free(triangles);
+}
+
+/* Cercle unité, avec assez de segments pour sa taille à l'écran */
+void meshCircle(MeshBuilder* builder) {
+	float radius = builder->pixelsPerUnit * transformScale(&builder->stack[builder->top]);
+	int segments = circleSegments(radius);
+	const GLfloat* circle = getUnitCircle(segments);
+	if (!circle) {
+		return;
+	}
+	builder->segments += segments;
+	meshColor3ub(builder, 255, 255, 255);
+	meshPolygon(builder, circle, segments);
 }
 
-void drawCarre(float x, float y,float largeur, float longueur, int r, int v, int b){
+/* Rectangle plein de coin (x, y), longueur selon x et largeur selon y */
+void meshCarre(MeshBuilder* builder, float x, float y, float largeur, float longueur, int r, int v, int b) {
 	float x2 = x + longueur;
 	float y2 = y + largeur;
-    glBegin(GL_QUADS);
-        glColor3ub(r,v,b);
-        glVertex2f(x, y);
-        glVertex2f(x2, y);
-        glVertex2f(x2, y2);
-        glVertex2f(x, y2);
-    glEnd();
-}
-
-/* carré arrondis */ 
-void drawRoundedSquare(float x, float y){
-   glPushMatrix();
-        glScalef(0.25,0.25,0);
-        glTranslatef(-2*x,2*y,0);
-        drawCircle();
-   glPopMatrix();
-
-   glPushMatrix();
-        glScalef(0.25,0.25,0);
-        glTranslatef(2*x,2*y,0);
-        drawCircle();
-   glPopMatrix();
-
-   glPushMatrix();
-        glScalef(0.25,0.25,0);
-        glTranslatef(-2*x,-2*y,0);
-        drawCircle();
-   glPopMatrix();
-
-   glPushMatrix();
-        glScalef(0.25,0.25,0);
-        glTranslatef(2*x,-2*y,0);
-        drawCircle();
-   glPopMatrix();
-
-  glPushMatrix();
-      glScalef(0.5,0.5,0);
-    drawCarre(-1*x,-1.5*y,(3*x),(2*y),255,255,255);
-  glPopMatrix();
-
-   glPushMatrix();
-    glScalef(0.5,0.5,0);
-    drawCarre(-1.5*x,-1*y,(2*x),(3*y),255,255,255);
-   glPopMatrix();
-}
-
-
-
-GLuint createdrawFirstArm(){
-GLuint first;
-first = glGenLists(1);
-
-glNewList(first, GL_COMPILE);
-/* 2 cercles et parralélépipède */ 
-glPushMatrix();
-    glScalef(2,2,0);
-   glPushMatrix();
-        glTranslatef(-0.3,0,0);
-        glScalef(0.2,0.2,0);
-        drawCircle();
-   glPopMatrix();
-
-   glPushMatrix();
-        glTranslatef(0.3,0,0);
-        glScalef(0.1,0.1,0);
-        drawCircle();
-   glPopMatrix();
-
-/* quadrilapède central   */
-    glPushMatrix();
-    glBegin(GL_POLYGON);
-        glVertex2f(-0.3,-0.2);
-        glVertex2f(0.3, -0.1);
-        glVertex2f(0.3,0.1);
-        glVertex2f(-0.3,0.2);
-    glEnd();
-    glPopMatrix();
-  glPopMatrix();
-
-glEndList();
-return first;
-}
-
-GLuint createdrawSecondArm(){
-GLuint second;
-second = glGenLists(1);
-glNewList(second, GL_COMPILE);
-
- glPushMatrix();
-    glScalef(0.20,0.20,0);
-    
- glPushMatrix();  
-    glTranslatef(3.,0,0);
-    drawRoundedSquare(1,1);
- glPopMatrix();
-	
- glPushMatrix();
-    glTranslatef(8,0,0);
-    drawRoundedSquare(1,1);
- glPopMatrix();
+	const GLfloat quad[] = {x, y, x2, y, x2, y2, x, y2};
+	meshColor3ub(builder, r, v, b);
+	meshPolygon(builder, quad, 4);
+}
+
+/* Carré aux coins arrondis : un cercle à chaque coin et deux rectangles en croix */
+void meshRoundedSquare(MeshBuilder* builder, float x, float y) {
+	int i;
+	const float corners[] = {-1, 1, 1, 1, -1, -1, 1, -1};
+	for(i=0; i<4; i++){
+		meshPushMatrix(builder);
+		meshScalef(builder, 0.25, 0.25);
+		meshTranslatef(builder, 2 * corners[2 * i] * x, 2 * corners[2 * i + 1] * y);
+		meshCircle(builder);
+		meshPopMatrix(builder);
+	}
+
+	meshPushMatrix(builder);
+	meshScalef(builder, 0.5, 0.5);
+	meshCarre(builder, -1*x, -1.5*y, (3*x), (2*y), 255, 255, 255);
+	meshCarre(builder, -1.5*x, -1*y, (2*x), (3*y), 255, 255, 255);
+	meshPopMatrix(builder);
+}
+
+/* Géométries des trois parties du bras */
+void buildFirstArm(MeshBuilder* builder) {
+	const GLfloat body[] = {-0.3, -0.2, 0.3, -0.1, 0.3, 0.1, -0.3, 0.2};
+
+	meshPushMatrix(builder);
+	meshScalef(builder, 2, 2);
+
+	meshPushMatrix(builder);
+	meshTranslatef(builder, -0.3, 0);
+	meshScalef(builder, 0.2, 0.2);
+	meshCircle(builder);
+	meshPopMatrix(builder);
+
+	meshPushMatrix(builder);
+	meshTranslatef(builder, 0.3, 0);
+	meshScalef(builder, 0.1, 0.1);
+	meshCircle(builder);
+	meshPopMatrix(builder);
+
+	meshPolygon(builder, body, 4);
+	meshPopMatrix(builder);
+}
+
+void buildSecondArm(MeshBuilder* builder) {
+	meshPushMatrix(builder);
+	meshScalef(builder, 0.20, 0.20);
+
+	meshPushMatrix(builder);
+	meshTranslatef(builder, 3., 0);
+	meshRoundedSquare(builder, 1, 1);
+	meshPopMatrix(builder);
+
+	meshPushMatrix(builder);
+	meshTranslatef(builder, 8, 0);
+	meshRoundedSquare(builder, 1, 1);
+	meshPopMatrix(builder);
+
+	meshPushMatrix(builder);
+	meshTranslatef(builder, 2, -1.25);
+	meshCarre(builder, 1, 1, 0.6, 4.6, 255, 255, 255);
+	meshPopMatrix(builder);
+
+	meshPopMatrix(builder);
+}
+
+void buildThirdArm(MeshBuilder* builder) {
+	meshPushMatrix(builder);
+	meshScalef(builder, 0.20, 0.20);
+
+	meshPushMatrix(builder);
+	meshTranslatef(builder, 8, 0);
+	meshScalef(builder, 0.5, 0.5);
+	meshRoundedSquare(builder, 1, 1);
+	meshPopMatrix(builder);
+
+	meshPushMatrix(builder);
+	meshTranslatef(builder, 7, -1.25);
+	meshCarre(builder, 1, 1, 0.4, 4, 255, 255, 255);
+	meshPopMatrix(builder);
 
- glPushMatrix();
-    glTranslatef(2,-1.25,0);
-    drawCarre(1,1,0.6,4.6,255,255,255);
- glPopMatrix();
+	meshPushMatrix(builder);
+	meshTranslatef(builder, 12, 0);
+	meshScalef(builder, 0.4, 0.4);
+	meshCircle(builder);
+	meshPopMatrix(builder);
 
- glPopMatrix();
+	meshPopMatrix(builder);
+}
 
-glEndList();
-return second;
+/* Construit les sommets côté CPU et renvoie le nombre de segments de cercle utilisés */
+unsigned int buildMesh(Mesh* mesh, void (*build)(MeshBuilder*), float scale) {
+	MeshBuilder builder;
+	initMesh(mesh);
+	beginMesh(&builder, mesh, scale);
+	build(&builder);
+	return builder.segments;
 }
 
-GLuint createdrawThirdArm(){
-GLuint third;
-third = glGenLists(1);
-glNewList(third, GL_COMPILE);
+/*
+Dessin instancié : un maillage est dessiné en un seul glDrawArraysInstanced() pour toutes ses copies.
+La transformation de chaque copie (a, b, c, d, tx, ty) est un attribut de sommet avancé une fois par instance.
+Sans OpenGL 3.3 (ou si le shader ne compile pas), on retombe sur un glMultMatrixf() + drawMesh() par copie.
+*/
+enum {
+	ATTRIB_POSITION = 0,
+	ATTRIB_COLOR = 1,
+	ATTRIB_INSTANCE_LINEAR = 2,
+	ATTRIB_INSTANCE_OFFSET = 3
+};
 
-glPushMatrix();
-    glScalef(0.20,0.20,0);
+static const char* INSTANCING_VERTEX_SHADER =
+	"#version 120\n"
+	"attribute vec2 position;\n"
+	"attribute vec4 color;\n"
+	"attribute vec4 instanceLinear;\n"
+	"attribute vec2 instanceOffset;\n"
+	"varying vec4 vertexColor;\n"
+	"void main() {\n"
+	"	vec2 p = mat2(instanceLinear) * position + instanceOffset;\n"
+	"	gl_Position = gl_ModelViewProjectionMatrix * vec4(p, 0.0, 1.0);\n"
+	"	vertexColor = color;\n"
+	"}\n";
+
+static const char* INSTANCING_FRAGMENT_SHADER =
+	"#version 120\n"
+	"varying vec4 vertexColor;\n"
+	"void main() {\n"
+	"	gl_FragColor = vertexColor;\n"
+	"}\n";
+
+static GLuint instancingProgram = 0;
+static GLuint instanceBuffer = 0;
+
+GLuint compileShader(GLenum type, const char* source) {
+	GLint status;
+	GLuint shader = glCreateShader(type);
+	glShaderSource(shader, 1, &source, NULL);
+	glCompileShader(shader);
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+	if (!status) {
+		char log[512];
+		glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+		fprintf(stderr, "Erreur de compilation du shader : %s\n", log);
+		glDeleteShader(shader);
+		return 0;
+	}
+	return shader;
+}
 
-glPushMatrix();
-    glTranslatef(8,0,0); 
-    glScalef(0.5,0.5,0);
-    drawRoundedSquare(1,1);
-glPopMatrix();
+int initInstancing() {
+	int major = 0, minor = 0;
+	const char* version = (const char*) glGetString(GL_VERSION);
+	if (!version || sscanf(version, "%d.%d", &major, &minor) != 2 || major * 10 + minor < 33) {
+		return 0;
+	}
 
- glPushMatrix();
-    glTranslatef(7,-1.25,0);
-    drawCarre(1,1,0.4,4,255,255,255);
- glPopMatrix();
+	GLuint vertexShader = compileShader(GL_VERTEX_SHADER, INSTANCING_VERTEX_SHADER);
+	GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, INSTANCING_FRAGMENT_SHADER);
+	if (!vertexShader || !fragmentShader) {
+		glDeleteShader(vertexShader);
+		glDeleteShader(fragmentShader);
+		return 0;
+	}
 
- glPushMatrix();
-        glTranslatef(12,0,0);
-        glScalef(0.4,0.4,0);
-        drawCircle();
- glPopMatrix();
+	GLint status;
+	GLuint program = glCreateProgram();
+	glAttachShader(program, vertexShader);
+	glAttachShader(program, fragmentShader);
+	glBindAttribLocation(program, ATTRIB_POSITION, "position");
+	glBindAttribLocation(program, ATTRIB_COLOR, "color");
+	glBindAttribLocation(program, ATTRIB_INSTANCE_LINEAR, "instanceLinear");
+	glBindAttribLocation(program, ATTRIB_INSTANCE_OFFSET, "instanceOffset");
+	glLinkProgram(program);
+	glDeleteShader(vertexShader);
+	glDeleteShader(fragmentShader);
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+	if (!status) {
+		glDeleteProgram(program);
+		return 0;
+	}
 
-glPopMatrix();
-glEndList();
-return third;
+	instancingProgram = program;
+	glGenBuffers(1, &instanceBuffer);
+	return 1;
 }
 
+/* Après un changement de contexte, les noms ne sont plus valides : on les oublie sans les supprimer */
+void forgetInstancing() {
+	instancingProgram = 0;
+	instanceBuffer = 0;
+}
 
-void Arm(){
+void deleteInstancing() {
+	if (instancingProgram) {
+		glDeleteProgram(instancingProgram);
+		glDeleteBuffers(1, &instanceBuffer);
+		instancingProgram = 0;
+		instanceBuffer = 0;
+	}
+}
 
-glPushMatrix();
-glPushMatrix();
-       glRotatef(45,0.0,0.0,1.0);
-       createdrawFirstArm();
-glPopMatrix();
+void drawMeshInstanced(const Mesh* mesh, const Transform2D* instances, unsigned int count) {
+	unsigned int i;
+	if (!instancingProgram) {
+		for(i=0; i<count; i++){
+			GLfloat m[16];
+			transformToMatrix(&instances[i], m);
+			glPushMatrix();
+			glMultMatrixf(m);
+			drawMesh(mesh);
+			glPopMatrix();
+		}
+		return;
+	}
 
-glPushMatrix();
-       glTranslatef(-0.1,0.4,0);
-       createdrawSecondArm();
-glPopMatrix();
+	glUseProgram(instancingProgram);
+
+	glBindBuffer(GL_ARRAY_BUFFER, mesh->vbo);
+	glEnableVertexAttribArray(ATTRIB_POSITION);
+	glEnableVertexAttribArray(ATTRIB_COLOR);
+	glVertexAttribPointer(ATTRIB_POSITION, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const GLvoid*) 0);
+	glVertexAttribPointer(ATTRIB_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), (const GLvoid*) (2 * sizeof(float)));
+
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+	glBufferData(GL_ARRAY_BUFFER, count * sizeof(Transform2D), instances, GL_STREAM_DRAW);
+	glEnableVertexAttribArray(ATTRIB_INSTANCE_LINEAR);
+	glEnableVertexAttribArray(ATTRIB_INSTANCE_OFFSET);
+	glVertexAttribPointer(ATTRIB_INSTANCE_LINEAR, 4, GL_FLOAT, GL_FALSE, sizeof(Transform2D), (const GLvoid*) 0);
+	glVertexAttribPointer(ATTRIB_INSTANCE_OFFSET, 2, GL_FLOAT, GL_FALSE, sizeof(Transform2D), (const GLvoid*) (4 * sizeof(float)));
+	glVertexAttribDivisor(ATTRIB_INSTANCE_LINEAR, 1);
+	glVertexAttribDivisor(ATTRIB_INSTANCE_OFFSET, 1);
+
+	glDrawArraysInstanced(GL_TRIANGLES, 0, mesh->count, count);
+
+	glVertexAttribDivisor(ATTRIB_INSTANCE_LINEAR, 0);
+	glVertexAttribDivisor(ATTRIB_INSTANCE_OFFSET, 0);
+	glDisableVertexAttribArray(ATTRIB_INSTANCE_OFFSET);
+	glDisableVertexAttribArray(ATTRIB_INSTANCE_LINEAR);
+	glDisableVertexAttribArray(ATTRIB_COLOR);
+	glDisableVertexAttribArray(ATTRIB_POSITION);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glUseProgram(0);
+}
 
-glPushMatrix();
-       glTranslatef(0.1,-0.5,0);
-       glRotatef(35,0.0,0.0,1.0);
-       createdrawThirdArm();
-glPopMatrix();
+/*
+Cache des ressources GPU du bras : le maillage de chaque partie est construit une seule fois pour un niveau de détail
+des cercles donné, partagé par compteur de références, puis libéré avec glDeleteBuffers().
+Toutes les copies d'une partie partagent son maillage : ses cercles sont découpés pour la plus grande d'entre elles.
+*/
+typedef enum ArmPart {
+	ARM_FIRST,
+	ARM_SECOND,
+	ARM_THIRD,
+	NB_ARM_PARTS
+} ArmPart;
+
+typedef struct ArmResource {
+	void (*buildMesh)(MeshBuilder*);
+	Mesh mesh; // vbo à 0 tant que le maillage n'est pas envoyé au GPU
+	float scale; // plus grande échelle des copies dessinées
+	unsigned int segments; // segments de cercle du maillage construit
+	unsigned int refCount;
+} ArmResource;
+
+static ArmResource armResources[NB_ARM_PARTS] = {
+	{buildFirstArm, {NULL, 0, 0, 0}, 1},
+	{buildSecondArm, {NULL, 0, 0, 0}, 1},
+	{buildThirdArm, {NULL, 0, 0, 0}, 1}
+};
 
-glPushMatrix();
-       glTranslatef(0.2,1.3,0);
-       glRotatef(-35,0.0,0.0,1.0);
-       createdrawThirdArm();
-glPopMatrix();
+/* Écart relatif d'échelle en deçà duquel le maillage n'est pas reconstruit (arrondis d'une rotation, par exemple) */
+#define ARM_SCALE_TOLERANCE 0.01f
+
+const Mesh* armMesh(ArmPart part) {
+	assert(part < NB_ARM_PARTS);
+	ArmResource* resource = &armResources[part];
+	if (!resource->mesh.vbo) {
+		if (resource->mesh.count) {
+            /* Les sommets sont encore en mémoire (perte de contexte) : il suffit de les renvoyer */
+			uploadMesh(&resource->mesh);
+		} else {
+			resource->segments = buildMesh(&resource->mesh, resource->buildMesh, resource->scale);
+			uploadMesh(&resource->mesh);
+		}
+	}
+	return &resource->mesh;
+}
 
-glPushMatrix();
-       glTranslatef(0,-.05,0);
-       glRotatef(15,0.0,0.0,1.0);
-       createdrawThirdArm();
-glPopMatrix();
+ArmPart acquireArmPart(ArmPart part) {
+	armMesh(part);
+	armResources[part].refCount++;
+	return part;
+}
 
-glPushMatrix();
-       glTranslatef(0,0.8,0);
-       glRotatef(-15,0.0,0.0,1.0);
-       createdrawThirdArm();
-glPopMatrix();
+void freeArmResource(ArmResource* resource) {
+	deleteMesh(&resource->mesh);
+}
 
-glPopMatrix();
+void releaseArmPart(ArmPart part) {
+	assert(part < NB_ARM_PARTS);
+	ArmResource* resource = &armResources[part];
+	assert(resource->refCount > 0);
+	resource->refCount--;
+	if (resource->refCount == 0) {
+		freeArmResource(resource);
+	}
+}
 
+void deleteArmResources() {
+	int i;
+	for(i=0; i<NB_ARM_PARTS; i++){
+		freeArmResource(&armResources[i]);
+		armResources[i].refCount = 0;
+	}
 }
 
-void resizeViewport() {
-	glViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
-    //glMatrixMode(GL_PROJECTION);
-	glMatrixMode(GL_MODELVIEW);
-	glLoadIdentity();
-	gluOrtho2D(-4., 4., -3., 3.);
-	SDL_SetVideoMode(WINDOW_WIDTH, WINDOW_HEIGHT, BIT_PER_PIXEL, SDL_OPENGL | SDL_RESIZABLE);
-}
-
-
-static const unsigned char COLORS[] = {
-	255, 255, 255,
-	0, 0, 0,
-	255, 0, 0,
-	0, 255, 0,
-	0, 0, 255,
-	255, 255, 0,
-	0, 255, 255,
-	255, 0, 255
+/* Après une perte de contexte, les noms OpenGL ne sont plus valides : on les oublie sans les supprimer */
+void invalidateArmResources() {
+	int i;
+	for(i=0; i<NB_ARM_PARTS; i++){
+		armResources[i].mesh.vbo = 0;
+	}
+}
+
+/* Génération du contexte OpenGL dans laquelle les ressources GPU de tp3 ont été créées */
+static unsigned int resourcesGeneration = 0;
+
+/*
+Après un changement de contexte (voir checkContext()), toutes les ressources GPU sont recréées : VBO des primitives,
+programme d'instanciation et maillages du bras, au prochain dessin. Le repère est refait par resizeViewport().
+*/
+void checkGLResources(PrimitiveList* list) {
+	Primitive* primitive;
+	if (resourcesGeneration == contextGeneration) {
+		return;
+	}
+	resourcesGeneration = contextGeneration;
+	glClearColor(0.1, 0.1, 0.1, 1.0); // un nouveau contexte repart de l'état par défaut
+	for (primitive = list->head; primitive; primitive = primitive->next) {
+		forgetPrimitiveBuffers(primitive);
+	}
+	forgetInstancing();
+	initInstancing();
+	invalidateArmResources();
+}
+
+/*
+Le détail des cercles dépend de leur taille à l'écran : après un zoom ou un redimensionnement, les sommets sont
+recalculés et renvoyés au GPU seulement si le nombre de segments a changé. Chaque cercle gagne des segments quand
+le zoom augmente, un total identique signifie donc des cercles identiques.
+*/
+void refreshArmResource(ArmResource* resource) {
+	if (!resource->mesh.count) {
+		return;
+	}
+	Mesh mesh;
+	unsigned int segments = buildMesh(&mesh, resource->buildMesh, resource->scale);
+	if (segments == resource->segments) {
+		deleteMesh(&mesh);
+		return;
+	}
+    /* On garde le tampon existant ; sans tampon (perte de contexte), armMesh() enverra les sommets */
+	mesh.vbo = resource->mesh.vbo;
+	free(resource->mesh.vertices);
+	resource->mesh = mesh;
+	resource->segments = segments;
+	if (mesh.vbo) {
+		uploadMesh(&resource->mesh);
+	}
+}
+
+void refreshArmResources() {
+	int i;
+	for(i=0; i<NB_ARM_PARTS; i++){
+		refreshArmResource(&armResources[i]);
+	}
+}
+
+/* Les copies d'une partie changent de taille : son maillage suit la plus grande */
+void setArmScale(ArmPart part, float scale) {
+	assert(part < NB_ARM_PARTS);
+	ArmResource* resource = &armResources[part];
+	if (scale > 0 && fabsf(scale - resource->scale) > ARM_SCALE_TOLERANCE * resource->scale) {
+		resource->scale = scale;
+		refreshArmResource(resource);
+	}
+}
+
+/* Produit de transformations : applique local puis parent (comme parent * local en matrices) */
+Transform2D combineTransforms(const Transform2D* parent, const Transform2D* local) {
+	Transform2D t;
+	t.a = parent->a * local->a + parent->c * local->b;
+	t.b = parent->b * local->a + parent->d * local->b;
+	t.c = parent->a * local->c + parent->c * local->d;
+	t.d = parent->b * local->c + parent->d * local->d;
+	t.tx = parent->a * local->tx + parent->c * local->ty + parent->tx;
+	t.ty = parent->b * local->tx + parent->d * local->ty + parent->ty;
+	return t;
+}
+
+/*
+Graphe de scène : chaque nœud porte une transformation locale (translation, rotation, échelle), ses enfants
+et éventuellement une partie du bras à dessiner. La transformation monde de chaque nœud est gardée en cache
+et n'est recalculée que si sa transformation locale ou celle d'un ancêtre a changé.
+*/
+#define NO_MESH -1
+
+typedef struct SceneNode {
+	float x, y; // translation
+	float angle; // rotation en degrés
+	float sx, sy; // échelle
+	int mesh; // ArmPart dessinée par le nœud, NO_MESH pour une simple articulation
+	Transform2D world;
+	int dirty; // transformation locale modifiée depuis la dernière mise à jour
+	int childDirty; // un descendant est à mettre à jour
+	struct SceneNode* parent;
+	struct SceneNode* firstChild;
+	struct SceneNode* lastChild;
+	struct SceneNode* nextSibling;
+} SceneNode;
+
+SceneNode* allocSceneNode(int mesh, float x, float y, float angle) {
+	SceneNode* node = (SceneNode*) malloc(sizeof(SceneNode));
+	if (!node) {
+		return NULL;
+	}
+	node->x = x;
+	node->y = y;
+	node->angle = angle;
+	node->sx = 1;
+	node->sy = 1;
+	node->mesh = mesh;
+	node->world = identityTransform();
+	node->dirty = 1;
+	node->childDirty = 0;
+	node->parent = NULL;
+	node->firstChild = NULL;
+	node->lastChild = NULL;
+	node->nextSibling = NULL;
+	return node;
+}
+
+void markSceneNodeDirty(SceneNode* node) {
+	assert(node);
+	node->dirty = 1;
+    /* Les ancêtres d'un nœud déjà signalé le sont aussi : on peut s'arrêter au premier */
+	SceneNode* parent = node->parent;
+	while (parent && !parent->childDirty) {
+		parent->childDirty = 1;
+		parent = parent->parent;
+	}
+}
+
+void addChildNode(SceneNode* parent, SceneNode* child) {
+	assert(parent);
+	assert(child);
+	child->parent = parent;
+	if (parent->lastChild) {
+		parent->lastChild->nextSibling = child;
+	} else {
+		parent->firstChild = child;
+	}
+	parent->lastChild = child;
+	markSceneNodeDirty(child);
+}
+
+SceneNode* addSceneNode(SceneNode* parent, int mesh, float x, float y, float angle) {
+	SceneNode* node = allocSceneNode(mesh, x, y, angle);
+	if (node) {
+		addChildNode(parent, node);
+	}
+	return node;
+}
+
+void moveSceneNode(SceneNode* node, float dx, float dy) {
+	node->x += dx;
+	node->y += dy;
+	markSceneNodeDirty(node);
+}
+
+void rotateSceneNode(SceneNode* node, float dangle) {
+	node->angle += dangle;
+	markSceneNodeDirty(node);
+}
+
+void scaleSceneNode(SceneNode* node, float sx, float sy) {
+	node->sx = sx;
+	node->sy = sy;
+	markSceneNodeDirty(node);
+}
+
+void deleteSceneNode(SceneNode* node) {
+	while (node) {
+		SceneNode* next = node->nextSibling;
+		deleteSceneNode(node->firstChild);
+		free(node);
+		node = next;
+	}
+}
+
+void updateSceneNode(SceneNode* node, const Transform2D* parentWorld, int parentChanged) {
+	int changed = parentChanged || node->dirty;
+	if (changed) {
+		Transform2D local = makeTransform(node->x, node->y, node->angle);
+		scaleTransform(&local, node->sx, node->sy);
+		node->world = combineTransforms(parentWorld, &local);
+		node->dirty = 0;
+	}
+	if (changed || node->childDirty) {
+        /* Les sous-arbres propres dont aucun ancêtre n'a bougé ne sont pas parcourus */
+		SceneNode* child;
+		for (child = node->firstChild; child; child = child->nextSibling) {
+			updateSceneNode(child, &node->world, changed);
+		}
+	}
+	node->childDirty = 0;
+}
+
+/* Liste aplatie des copies à dessiner, regroupées par partie du bras pour le dessin instancié */
+typedef struct SceneBatch {
+	Transform2D* instances[NB_ARM_PARTS];
+	unsigned int count[NB_ARM_PARTS];
+	unsigned int capacity[NB_ARM_PARTS];
+	float scale[NB_ARM_PARTS]; // plus grande échelle des copies, pour le niveau de détail du maillage partagé
+} SceneBatch;
+
+void initSceneBatch(SceneBatch* batch) {
+	memset(batch, 0, sizeof(SceneBatch));
+}
+
+void addToSceneBatch(SceneBatch* batch, int mesh, const Transform2D* world) {
+	assert(mesh >= 0 && mesh < NB_ARM_PARTS);
+	if (batch->count[mesh] == batch->capacity[mesh]) {
+		unsigned int capacity = batch->capacity[mesh] ? 2 * batch->capacity[mesh] : 8;
+		Transform2D* instances = (Transform2D*) realloc(batch->instances[mesh], capacity * sizeof(Transform2D));
+		if (!instances) {
+			return;
+		}
+		batch->instances[mesh] = instances;
+		batch->capacity[mesh] = capacity;
+	}
+	batch->instances[mesh][batch->count[mesh]++] = *world;
+	float scale = transformScale(world);
+	if (scale > batch->scale[mesh]) {
+		batch->scale[mesh] = scale;
+	}
+}
+
+void collectSceneNode(const SceneNode* node, SceneBatch* batch) {
+	for (; node; node = node->nextSibling) {
+		if (node->mesh != NO_MESH) {
+			addToSceneBatch(batch, node->mesh, &node->world);
+		}
+		collectSceneNode(node->firstChild, batch);
+	}
+}
+
+/* Met à jour les transformations monde et la liste aplatie, uniquement si quelque chose a changé */
+void updateScene(SceneNode* root, SceneBatch* batch) {
+	int i;
+	if (!root->dirty && !root->childDirty) {
+		return;
+	}
+	Transform2D identity = identityTransform();
+	updateSceneNode(root, &identity, 0);
+	for(i=0; i<NB_ARM_PARTS; i++){
+		batch->count[i] = 0;
+		batch->scale[i] = 0;
+	}
+	collectSceneNode(root, batch);
+}
+
+void drawSceneBatch(const SceneBatch* batch) {
+	int i;
+	for(i=0; i<NB_ARM_PARTS; i++){
+		if (batch->count[i]) {
+			setArmScale(i, batch->scale[i]);
+			drawMeshInstanced(armMesh(i), batch->instances[i], batch->count[i]);
+		}
+	}
+}
+
+void deleteSceneBatch(SceneBatch* batch) {
+	int i;
+	for(i=0; i<NB_ARM_PARTS; i++){
+		free(batch->instances[i]);
+	}
+	initSceneBatch(batch);
+}
+
+/* Étapes d'une image mesurées par le profileur */
+typedef enum FrameStage {
+	STAGE_LANDMARKS,
+	STAGE_ARM,
+	STAGE_PRIMITIVES, // dessin ou palette
+	STAGE_OVERLAY,
+	STAGE_EVENTS,
+	STAGE_SWAP,
+	STAGE_SLEEP,
+	NB_STAGES
+} FrameStage;
+
+static const char* STAGE_NAMES[NB_STAGES] = {"landmarks", "arm", "primitives", "overlay", "events", "swap", "sleep"};
+static const unsigned char STAGE_COLORS[3 * NB_STAGES] = {
+	0, 160, 255,
+	0, 220, 120,
+	255, 200, 0,
+	160, 160, 160,
+	255, 0, 255,
+	255, 60, 60,
+	40, 120, 40
 };
 
-static const unsigned int NB_COLORS = sizeof(COLORS) / (3 * sizeof(unsigned char));
+/* Scènes du banc d'essai propres à tp3, lancées après celles de runBenchmark() */
+#define BENCH_ARMS 1000 // nombre de bras complets dans le graphe de scène
+#define BENCH_ARM_SCALE 0.03f
 
-void drawColorPalette() {
+typedef struct BenchArms {
+	SceneNode* root;
+	SceneBatch batch;
+	int animated; // la racine tourne à chaque image : toutes les transformations sont recalculées
+} BenchArms;
+
+void benchDrawArms(void* data) {
+	BenchArms* arms = (BenchArms*) data;
+	if (arms->animated) {
+		rotateSceneNode(arms->root, 1);
+	}
+	updateScene(arms->root, &arms->batch);
+	drawSceneBatch(&arms->batch);
+}
+
+/* BENCH_ARMS bras de six parties, dessinés par instanciation */
+void benchArms(int animated) {
+	unsigned int i;
+	BenchResult result = {"arms", animated ? "animated" : "static", 0, BENCH_ARMS, 0, 0, 0, 0};
+	BenchArms arms;
+	arms.animated = animated;
+	initSceneBatch(&arms.batch);
+	benchSeed = 1;
+
+	long long start = getTimeNanoseconds();
+	arms.root = allocSceneNode(NO_MESH, 0, 0, 0);
+	for (i = 0; i < BENCH_ARMS; ++i) {
+		SceneNode* arm = addSceneNode(arms.root, NO_MESH, benchRandom(), benchRandom(), 180 * benchRandom());
+		scaleSceneNode(arm, BENCH_ARM_SCALE, BENCH_ARM_SCALE);
+		addSceneNode(arm, ARM_FIRST, 0, 0, 45);
+		addSceneNode(arm, ARM_SECOND, -0.1, 0.4, 0);
+		addSceneNode(arm, ARM_THIRD, 0.1, -0.5, 35);
+		addSceneNode(arm, ARM_THIRD, 0.2, 1.3, -35);
+		addSceneNode(arm, ARM_THIRD, 0, -.05, 15);
+		addSceneNode(arm, ARM_THIRD, 0, 0.8, -15);
+	}
+	updateScene(arms.root, &arms.batch);
+	result.buildMs = elapsedMilliseconds(start);
+
+	start = getTimeNanoseconds();
+	drawSceneBatch(&arms.batch);
+	glFinish();
+	result.uploadMs = elapsedMilliseconds(start);
+
+	result.drawMs = benchDraw(benchDrawArms, &arms);
+	result.memory = (1 + 7 * BENCH_ARMS) * sizeof(SceneNode);
+	for (i = 0; i < NB_ARM_PARTS; ++i) {
+		result.vertices += armMesh(i)->count * arms.batch.count[i];
+		result.memory += arms.batch.capacity[i] * sizeof(Transform2D) + armMesh(i)->count * sizeof(Vertex);
+	}
+	printBenchResult(&result);
+	deleteSceneBatch(&arms.batch);
+	deleteSceneNode(arms.root);
+}
+
+/* Options communes (voir parseCommonArgument()) */
+void parseArguments(int argc, char** argv) {
 	int i;
-    float dx = 2.f / NB_COLORS; // dx = "delta x"
-    glBegin(GL_QUADS);
-    for(i = 0; i < NB_COLORS; ++i) {
-    	glColor3ubv(COLORS + i * 3);
-    	glVertex2f(-1 + i * dx, -1);
-    	glVertex2f(-1 + (i + 1) * dx, -1);
-    	glVertex2f(-1 + (i + 1) * dx, 1);
-    	glVertex2f(-1 + i  * dx, 1);
-    }
-    glEnd();
+	for (i = 1; i < argc; ++i) {
+		if (!parseCommonArgument(argc, argv, &i)) {
+			fprintf(stderr, "Option inconnue : %s\n", argv[i]);
+		}
+	}
+}
+
+/* Vue par défaut : [-4, 4] x [-3, 3] */
+static Camera camera = {0, 0, 1, 4, 3};
+
+/* Le contexte a pu être recréé par SDL_SetVideoMode() : viewport et projection sont posés après */
+void resizeViewport() {
+	if (!headless) {
+		SDL_SetVideoMode(WINDOW_WIDTH, WINDOW_HEIGHT, BIT_PER_PIXEL, SDL_OPENGL | SDL_RESIZABLE);
+	}
+	checkContext();
+	glViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
+	applyCamera(&camera);
+	buildLandmarks(-4, 4, -3, 3, LANDMARK_SPACING, LANDMARK_TICK_SIZE);
 }
 
+/* Délai maximal d'attente d'un évènement quand la scène n'a pas changé */
+static const Uint32 IDLE_TIMEOUT_MILLISECONDS = 500;
+
+/* Côté des cellules de l'index spatial du dessin, en unités du plan */
+#define DRAWING_CELL_SIZE 0.25f
+#define PICK_TOLERANCE_PIXELS 6 // distance à l'écran au-delà de laquelle un clic ne touche pas une primitive
+
 int main(int argc, char** argv) {
  
 
@@ -411,97 +1027,128 @@ int main(int argc, char** argv) {
 
 	//int iterationTime=5.0; // 5 secondes par déplacement
 
-    /* Initialisation de la SDL */
-	if(-1 == SDL_Init(SDL_INIT_VIDEO)) {
+	initProfiler(STAGE_NAMES, STAGE_COLORS, NB_STAGES);
+	parseArguments(argc, argv);
+
+    /* Initialisation de la SDL (sans la vidéo en mode sans fenêtre) */
+	if(-1 == SDL_Init((headless ? 0 : SDL_INIT_VIDEO) | SDL_INIT_TIMER)) {
 		fprintf(stderr, "Impossible d'initialiser la SDL. Fin du programme.\n");
 		return EXIT_FAILURE;
 	}
 
-    /* Ouverture d'une fenêtre et création d'un contexte OpenGL */
-	if(NULL == SDL_SetVideoMode(WINDOW_WIDTH, WINDOW_HEIGHT, BIT_PER_PIXEL, SDL_OPENGL | SDL_RESIZABLE)) {
-		fprintf(stderr, "Impossible d'ouvrir la fenetre. Fin du programme.\n");
-		return EXIT_FAILURE;
+	if (headless) {
+        /* Création d'un contexte OpenGL hors écran */
+		if (!createHeadlessContext(WINDOW_WIDTH, WINDOW_HEIGHT)) {
+			fprintf(stderr, "Impossible de créer le contexte hors écran. Fin du programme.\n");
+			SDL_Quit();
+			return EXIT_FAILURE;
+		}
+	} else {
+        /* Ouverture d'une fenêtre et création d'un contexte OpenGL */
+		SDL_GL_SetAttribute(SDL_GL_SWAP_CONTROL, vsync);
+		if(NULL == SDL_SetVideoMode(WINDOW_WIDTH, WINDOW_HEIGHT, BIT_PER_PIXEL, SDL_OPENGL | SDL_RESIZABLE)) {
+			fprintf(stderr, "Impossible d'ouvrir la fenetre. Fin du programme.\n");
+			return EXIT_FAILURE;
+		}
+		SDL_WM_SetCaption("Paint IMAC", NULL);
 	}
-	SDL_WM_SetCaption("Paint IMAC", NULL);
 
+    resizeViewport();
 	glClearColor(0.1, 0.1, 0.1, 1.0);
 	glClear(GL_COLOR_BUFFER_BIT);
-    resizeViewport();
+
+    /* Toute la mémoire du dessin est prise dans cette arène */
+	Arena drawing;
+	initArena(&drawing);
 
     /* On créé une première primitive par défaut */
-	PrimitiveList primitives = allocPrimitive(GL_LINE_STRIP);
+	PrimitiveList primitives;
+	initPrimitiveList(&primitives);
+	addPrimitive(allocPrimitive(&drawing, GL_LINE_STRIP), &primitives);
+
+    /* Index spatial : seules les primitives visibles sont dessinées */
+	SpatialGrid grid;
+	initSpatialGrid(&grid, DRAWING_CELL_SIZE);
 	
-   	GLuint first = createdrawFirstArm();
-	GLuint second = createdrawSecondArm();
-	GLuint third = createdrawThirdArm();
+    /* Parties du bras, construites une fois par le cache de ressources */
+	if (!initInstancing()) {
+		fprintf(stderr, "Dessin instancié indisponible, une copie par appel de dessin.\n");
+	}
+	ArmPart first = acquireArmPart(ARM_FIRST);
+	ArmPart second = acquireArmPart(ARM_SECOND);
+	ArmPart third = acquireArmPart(ARM_THIRD);
+
+    /* Graphe de scène du bras : la racine est déplacée par les flèches, l'épaule par o / m */
+	SceneNode* arm = allocSceneNode(NO_MESH, 0, 0, 0);
+	SceneNode* shoulder = addSceneNode(arm, first, 0, 0, 45);
+	addSceneNode(arm, second, -0.1, 0.4, 0);
+	addSceneNode(arm, third, 0.1, -0.5, 35);
+	addSceneNode(arm, third, 0.2, 1.3, -35);
+	addSceneNode(arm, third, 0, -.05, 15);
+	addSceneNode(arm, third, 0, 0.8, -15);
+	SceneBatch armBatch;
+	initSceneBatch(&armBatch);
+
+    /* Banc d'essai : les scènes synthétiques remplacent la boucle d'affichage */
+	if (benchmark) {
+		runBenchmark("tp3");
+		benchArms(0);
+		benchArms(1);
+	}
 
-	int loop = 1;
+	int loop = !benchmark;
+	FrameScheduler scheduler;
+	initFrameScheduler(&scheduler);
+    int sceneDirty = 1; // la scène doit être redessinée à la prochaine image
     int mode = 0; // le mode d'affichage. 0 = le dessin, 1 = la palette
    // unsigned int currentColor = 0; // l'index de la couleur courante dans le tableau COLORS
 
     /* Boucle d'affichage */
     while(loop) {
-        /* Récupération du temps au début de la boucle */
-    	Uint32 startTime = SDL_GetTicks();
-
-        /* Code de dessin */
-
-        glClear(GL_COLOR_BUFFER_BIT); // Toujours commencer par clear le buffer
-
-
-        drawLandmarks();
-        drawLandmark();
-	//drawRoundedSquare(1.,1.);
-       
-	//Arm();
-	glPushMatrix();
-
-	glPushMatrix();
-	       glRotatef(45,0.0,0.0,1.0);
-	       glCallList(first);
-	glPopMatrix();
-
-	glPushMatrix();
-	       glTranslatef(-0.1,0.4,0);
-	       glCallList(second);
-	glPopMatrix();
-
-	glPushMatrix();
-	       glTranslatef(0.1,-0.5,0);
-	       glRotatef(35,0.0,0.0,1.0);
-	       glCallList(third);
-	glPopMatrix();
-
-	glPushMatrix();
-	       glTranslatef(0.2,1.3,0);
-	       glRotatef(-35,0.0,0.0,1.0);
-	       glCallList(third);
-	glPopMatrix();
-		
-	glPushMatrix();
-	       glTranslatef(0,-.05,0);
-	       glRotatef(15,0.0,0.0,1.0);
-	       glCallList(third);
-	glPopMatrix();
-
-	glPushMatrix();
-	       glTranslatef(0,0.8,0);
-	       glRotatef(-15,0.0,0.0,1.0);
-	       glCallList(third);
-	glPopMatrix();
-
-	glPopMatrix();
-
-        if (mode == 0) {
-            drawPrimitives(primitives); // On dessine la liste de primitives
-        }
-        else if (mode == 1) {
-        	drawColorPalette();
+    	beginProfileFrame();
+
+        /* Code de dessin : uniquement si la scène a changé depuis la dernière image */
+        int redrawn = sceneDirty;
+        if (redrawn) {
+            glClear(GL_COLOR_BUFFER_BIT); // Toujours commencer par clear le buffer
+
+
+            drawLandmarks();
+            endProfileStage(STAGE_LANDMARKS);
+
+            /* Un seul appel de dessin par maillage, quel que soit le nombre de copies */
+            updateScene(arm, &armBatch);
+            drawSceneBatch(&armBatch);
+            endProfileStage(STAGE_ARM);
+
+            if (mode == 0) {
+                drawVisiblePrimitives(&primitives, &grid); // On dessine les primitives visibles
+            }
+            else if (mode == 1) {
+            	drawColorPalette();
+            }
+            endProfileStage(STAGE_PRIMITIVES);
+
+            if (profiler.showOverlay) {
+            	drawProfileOverlay();
+            }
+            endProfileStage(STAGE_OVERLAY);
+
+            sceneDirty = 0;
         }
 
         /* Boucle traitant les evenements */
         SDL_Event e;
-        while(SDL_PollEvent(&e)) {
+        int hasEvent = SDL_PollEvent(&e);
+        if (!hasEvent && !redrawn && !sceneDirty && !headless) {
+            /* Rien à redessiner : on bloque jusqu'au prochain évènement plutôt que de tourner à vide */
+            hasEvent = waitEventTimeout(&e, IDLE_TIMEOUT_MILLISECONDS);
+        }
+        for(; hasEvent; hasEvent = SDL_PollEvent(&e)) {
+
+            if (isSceneEvent(&e)) {
+                sceneDirty = 1;
+            }
 
             /* L'utilisateur ferme la fenêtre : */
 
@@ -510,6 +1157,38 @@ int main(int argc, char** argv) {
         		break;
         	}
 
+        	if(e.type == SDL_MOUSEBUTTONDOWN && handleCameraWheel(&camera, &e.button)){
+        		applyCamera(&camera);
+        		refreshArmResources();
+        		continue;
+        	}
+
+        	if(e.type == SDL_MOUSEBUTTONDOWN && e.button.button == SDL_BUTTON_RIGHT){
+        		/* Clic droit : primitive sous la souris */
+        		float x, y;
+        		if (windowToPlane(e.button.x, e.button.y, &x, &y)) {
+        			/* La tolérance est fixée à l'écran : elle suit le zoom dans le plan */
+        			float tolerance = windowLengthToPlane(PICK_TOLERANCE_PIXELS);
+        			Primitive* picked = pickPrimitive(&primitives, &grid, x, y, tolerance);
+        			if (picked) {
+        				printf("primitive %u (type %u, %u sommets) en %f %f\n", picked->index, picked->primitiveType,
+        					primitiveVertexCount(picked), x, y);
+        			} else {
+        				printf("aucune primitive en %f %f\n", x, y);
+        			}
+        		}
+        		continue;
+        	}
+
+        	if(e.type == SDL_MOUSEBUTTONDOWN && e.button.button == SDL_BUTTON_LEFT && mode == 0){
+        		/* Clic gauche : un point de plus dans la primitive courante */
+        		float x, y;
+        		if (primitives.tail && windowToPlane(e.button.x, e.button.y, &x, &y)) {
+        			addPointToPrimitive(primitives.tail, x, y, 255, 255, 255);
+        		}
+        		continue;
+        	}
+
             /* Quelques exemples de traitement d'evenements : */
         	switch(e.type) {
 
@@ -522,6 +1201,15 @@ int main(int argc, char** argv) {
         			mode = 1;
         		}
 
+        		/* Caméra : les flèches seules déplacent le bras, avec Maj elles déplacent la vue */
+        		int arrow = e.key.keysym.sym == SDLK_UP || e.key.keysym.sym == SDLK_DOWN
+        			|| e.key.keysym.sym == SDLK_LEFT || e.key.keysym.sym == SDLK_RIGHT;
+        		if ((!arrow || (e.key.keysym.mod & KMOD_SHIFT)) && handleCameraKey(&camera, e.key.keysym.sym)) {
+        			applyCamera(&camera);
+        			refreshArmResources();
+        			break;
+        		}
+
         		switch(e.key.keysym.sym) {
 
         			case SDLK_q:
@@ -532,45 +1220,50 @@ int main(int argc, char** argv) {
         			mode = 1;
         			break;
 
+        			case SDLK_f:
+        			profiler.showOverlay = !profiler.showOverlay;
+        			break;
+
         			case SDLK_o:
+                    rotateSceneNode(shoulder, 5);
                     break;
 
                     case SDLK_m:
-        			//glRotatef(-45,0.0,0.0,1.0);
-        			//glTranslatef(0.2,0,0);
+                    rotateSceneNode(shoulder, -5);
                     break;
 
                     case SDLK_n:
-                    glTranslatef(0.2,0,0);
-                    glRotatef(-45,0.0,0.0,1.0);
-                   // drawCarre(&primitives,0.2,0.7,0.3,0.2,200,200,200);
+                    /* Comme glTranslatef(0.2,0,0) puis glRotatef(-45,...), mais sur le bras seul : la modelview reste l'identité */
+                    moveSceneNode(arm, 0.2 * cos(arm->angle * M_PI / 180.), 0.2 * sin(arm->angle * M_PI / 180.));
+                    rotateSceneNode(arm, -45);
                     break;
 
                     case SDLK_UP:
-                    glTranslatef(0,0.2,0);
+                    moveSceneNode(arm,0,0.2);
                     break;
 
                     case SDLK_DOWN:
-                    glTranslatef(0,-0.2,0);
+                    moveSceneNode(arm,0,-0.2);
                     break;
 
                     case SDLK_LEFT:
-                    glTranslatef(-0.2,0,0);
+                    moveSceneNode(arm,-0.2,0);
                     break;
 
 
                     case SDLK_RIGHT:
-                    glTranslatef(0.2,0,0);
+                    moveSceneNode(arm,0.2,0);
                     break;
 
                     case SDLK_p:
-                    addPrimitive(allocPrimitive(GL_POINTS), &primitives);
+                    addPrimitive(allocPrimitive(&drawing, GL_POINTS), &primitives);
                     break;
 
                     case SDLK_c:
                             /* Touche pour effacer le dessin */
-                            deletePrimitive(&primitives); // on supprime les primitives actuelles
-                            addPrimitive(allocPrimitive(GL_POINTS), &primitives); // on réinitialise à la primitive courante
+                            deletePrimitive(&primitives, &drawing); // on supprime les primitives actuelles
+                            invalidateSpatialGrid(&grid);
+                            addPrimitive(allocPrimitive(&drawing, GL_POINTS), &primitives); // on réinitialise à la primitive courante
                             break;
 
                             default:
@@ -589,25 +1282,67 @@ int main(int argc, char** argv) {
                         WINDOW_WIDTH = e.resize.w;
                         WINDOW_HEIGHT = e.resize.h;
                         resizeViewport();
+                        checkGLResources(&primitives);
+                        refreshArmResources();
 
                         default:
                         break;
                     }
                 }
 
+                endProfileStage(STAGE_EVENTS);
+
         /* Echange du front et du back buffer : mise à jour de la fenêtre */
-                SDL_GL_SwapBuffers();
+                if (redrawn) {
+                	swapBuffers();
+                	endProfileStage(STAGE_SWAP);
+                }
 
-        /* Calcul du temps écoulé */
-                Uint32 elapsedTime = SDL_GetTicks() - startTime;
+        /* La courbe de profilage est mise à jour à chaque image tant qu'elle est affichée */
+                if (profiler.showOverlay) {
+                	sceneDirty = 1;
+                }
+
+        /* Sans fenêtre, on redessine à chaque tour jusqu'au nombre d'images demandé */
+                if (headless) {
+                	sceneDirty = 1;
+                	if (frameNumber >= headlessFrames) {
+                		loop = 0;
+                	}
+                }
 
-        /* Si trop peu de temps s'est écoulé, on met en pause le programme */
-                if(elapsedTime < FRAMERATE_MILLISECONDS) {
-                	SDL_Delay(FRAMERATE_MILLISECONDS - elapsedTime);
+        /* Pause jusqu'à l'échéance de l'image suivante */
+                if(redrawn && !headless) {
+                	waitNextFrame(&scheduler);
                 }
+
+        /* Seules les images réellement redessinées sont comptées */
+                if (redrawn) {
+                	endProfileStage(STAGE_SLEEP);
+                	endProfileFrame();
+                }
+            }
+
+            deletePrimitive(&primitives, &drawing);
+            deleteSpatialGrid(&grid);
+            deleteSceneBatch(&armBatch);
+            deleteSceneNode(arm);
+            releaseArmPart(first);
+            releaseArmPart(second);
+            releaseArmPart(third);
+            deleteArmResources();
+            deleteInstancing();
+            deleteCircleTables();
+            deleteLandmarks();
+
+            if (profileFile) {
+            	printProfileSummary(stdout);
+            	if (!writeProfileCSV(profileFile)) {
+            		fprintf(stderr, "Impossible d'écrire %s\n", profileFile);
+            	}
             }
 
-            deletePrimitive(&primitives);
+            destroyHeadlessContext();
 
     /* Liberation des ressources associées à la SDL */ 
             SDL_Quit();
@@ -1,75 +1,626 @@
-#include <SDL/SDL.h>
+#include "paint.h"
 #include <SDL/SDL_image.h>
-#include <GL/gl.h>
-#include <GL/glu.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
 
-static unsigned int WINDOW_WIDTH = 800;
-static unsigned int WINDOW_HEIGHT = 800;
+// Dimensions et cadence de la fenêtre, options --headless, --dump, --fps et --vsync : voir common/paint.h
 static const unsigned int BIT_PER_PIXEL = 32;
-static const Uint32 FRAMERATE_MILLISECONDS = 1000 / 60;
 
 void resizeViewport() {
     glViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
     glMatrixMode(GL_PROJECTION);
     glLoadIdentity();
     gluOrtho2D(-1., 1., -1., 1.);
-    SDL_SetVideoMode(WINDOW_WIDTH, WINDOW_HEIGHT, BIT_PER_PIXEL, SDL_OPENGL | SDL_RESIZABLE);
+    if(!headless) {
+        SDL_SetVideoMode(WINDOW_WIDTH, WINDOW_HEIGHT, BIT_PER_PIXEL, SDL_OPENGL | SDL_RESIZABLE);
+    }
+}
+
+#define NB_LOGOS 2
+static const char* LOGO_FILES[NB_LOGOS] = { "logo_imac_400x400.jpg", "logo_imac_400x400.png" };
+
+// Atlas des glyphes : les chiffres et les deux-points sont rangés dans une seule texture RGBA, pour dessiner
+// une chaîne entière (une horloge "12:34:56" par exemple) avec un seul glBindTexture et un seul glDrawArrays
+#define NB_GLYPHS 11
+#define ATLAS_WIDTH 128 // largeur de l'atlas, les glyphes y sont rangés par étagères
+#define ATLAS_PADDING 1 // pixels vides autour de chaque glyphe, pour que le filtrage ne déborde pas sur le voisin
+#define MAX_STRING_LENGTH 64
+
+static const char* GLYPH_CHARS = "0123456789:";
+static const char* GLYPH_FILES[NB_GLYPHS] = {
+    "0.png", "1.png", "2.png", "3.png", "4.png", "5.png", "6.png", "7.png", "8.png", "9.png", "colon.png"
+};
+
+typedef struct Glyph {
+    float u0, v0, u1, v1; // rectangle du glyphe dans l'atlas
+    float aspect; // largeur / hauteur
+} Glyph;
+
+typedef struct GlyphAtlas {
+    GLuint texture;
+    int width, height;
+    Glyph glyphs[NB_GLYPHS];
+} GlyphAtlas;
+
+// Lit un pixel d'une surface de 1 à 4 octets par pixel
+Uint32 getSurfacePixel(const SDL_Surface* surface, int x, int y) {
+    const Uint8* p = (const Uint8*) surface->pixels + y * surface->pitch + x * surface->format->BytesPerPixel;
+    switch(surface->format->BytesPerPixel) {
+        case 1:
+            return *p;
+        case 2:
+            return *(const Uint16*) p;
+        case 3:
+            if(SDL_BYTEORDER == SDL_BIG_ENDIAN) {
+                return p[0] << 16 | p[1] << 8 | p[2];
+            }
+            return p[0] | p[1] << 8 | p[2] << 16;
+        default:
+            return *(const Uint32*) p;
+    }
+}
+
+// Position dans le pixel de l'octet qui porte un canal, ou -1 si le canal ne tient pas dans un octet entier
+int channelByte(Uint32 mask, Uint8 shift, int bytesPerPixel) {
+    if(mask != (Uint32) 0xff << shift || shift % 8) {
+        return -1;
+    }
+    if(SDL_BYTEORDER == SDL_BIG_ENDIAN) {
+        return bytesPerPixel - 1 - shift / 8;
+    }
+    return shift / 8;
+}
+
+// Copie une surface, quel que soit son format, dans un tampon RGBA de pitch octets par ligne.
+// Le format est examiné une fois : les formats à un octet par canal (JPEG en 24 bits RGB ou BGR, PNG en 32 bits)
+// sont recopiés octet par octet, ou ligne par ligne s'ils sont déjà en RGBA ; les autres (palettes, 16 bits)
+// passent pixel par pixel par SDL_GetRGBA. Le pitch de la surface, qui peut comporter du bourrage, est respecté.
+void copySurfaceRGBA(SDL_Surface* surface, unsigned char* dst, int pitch) {
+    const SDL_PixelFormat* format = surface->format;
+    int bpp = format->BytesPerPixel;
+    int x, y;
+    int r = -1, g = -1, b = -1, a = -1;
+    if(bpp >= 3 && format->palette == NULL) {
+        r = channelByte(format->Rmask, format->Rshift, bpp);
+        g = channelByte(format->Gmask, format->Gshift, bpp);
+        b = channelByte(format->Bmask, format->Bshift, bpp);
+        a = format->Amask ? channelByte(format->Amask, format->Ashift, bpp) : 4; // 4 : pas d'alpha, opaque
+    }
+    SDL_LockSurface(surface);
+    for(y = 0; y < surface->h; ++y) {
+        const unsigned char* src = (const unsigned char*) surface->pixels + y * surface->pitch;
+        unsigned char* row = dst + y * pitch;
+        if(r == 0 && g == 1 && b == 2 && a == 3 && bpp == 4) {
+            memcpy(row, src, 4 * surface->w);
+        } else if(r >= 0 && g >= 0 && b >= 0 && a >= 0) {
+            for(x = 0; x < surface->w; ++x, src += bpp, row += 4) {
+                row[0] = src[r];
+                row[1] = src[g];
+                row[2] = src[b];
+                row[3] = a < 4 ? src[a] : 255;
+            }
+        } else {
+            for(x = 0; x < surface->w; ++x, row += 4) {
+                SDL_GetRGBA(getSurfacePixel(surface, x, y), surface->format, row, row + 1, row + 2, row + 3);
+            }
+        }
+    }
+    SDL_UnlockSurface(surface);
+}
+
+// Image décodée, prête pour glTexImage2D : pixels RGBA, lignes serrées
+typedef struct Image {
+    int width, height;
+    unsigned char* pixels;
+} Image;
+
+// Charge un fichier et le convertit en RGBA. Renvoie 0 en cas d'échec (image->pixels vaut alors NULL).
+// N'appelle pas OpenGL : peut tourner sur n'importe quel thread.
+int decodeImage(const char* filename, Image* image) {
+    image->width = image->height = 0;
+    image->pixels = NULL;
+    SDL_Surface* surface = IMG_Load(filename);
+    if(surface == NULL) {
+        return 0;
+    }
+    image->pixels = (unsigned char*) malloc(4 * surface->w * surface->h);
+    if(image->pixels != NULL) {
+        image->width = surface->w;
+        image->height = surface->h;
+        copySurfaceRGBA(surface, image->pixels, 4 * surface->w);
+    }
+    SDL_FreeSurface(surface);
+    return image->pixels != NULL;
+}
+
+void freeImage(Image* image) {
+    free(image->pixels);
+    image->pixels = NULL;
+}
+
+unsigned int nextPowerOfTwo(unsigned int n) {
+    unsigned int p = 1;
+    while(p < n) {
+        p *= 2;
+    }
+    return p;
+}
+
+// Range les images des glyphes (déjà décodées) dans une seule texture. Renvoie 0 si la mémoire manque.
+// Un glyphe dont l'image n'a pas pu être chargée (pixels à NULL) n'a pas de place dans l'atlas et se dessine sans largeur.
+int buildGlyphAtlas(GlyphAtlas* atlas, const Image images[NB_GLYPHS]) {
+    int order[NB_GLYPHS];
+    int posX[NB_GLYPHS], posY[NB_GLYPHS];
+    int i, j;
+
+    // Rangement en étagères, des glyphes les plus hauts aux plus bas pour perdre le moins de place
+    for(i = 0; i < NB_GLYPHS; ++i) {
+        for(j = i; j > 0 && images[order[j - 1]].height < images[i].height; --j) {
+            order[j] = order[j - 1];
+        }
+        order[j] = i;
+    }
+    int x = ATLAS_PADDING, y = ATLAS_PADDING, shelfHeight = 0;
+    for(j = 0; j < NB_GLYPHS; ++j) {
+        i = order[j];
+        posX[i] = posY[i] = 0;
+        if(images[i].pixels == NULL) {
+            continue;
+        }
+        if(x + images[i].width + ATLAS_PADDING > ATLAS_WIDTH) {
+            x = ATLAS_PADDING;
+            y += shelfHeight + ATLAS_PADDING;
+            shelfHeight = 0;
+        }
+        posX[i] = x;
+        posY[i] = y;
+        x += images[i].width + ATLAS_PADDING;
+        if(images[i].height > shelfHeight) {
+            shelfHeight = images[i].height;
+        }
+    }
+    atlas->width = ATLAS_WIDTH;
+    atlas->height = nextPowerOfTwo(y + shelfHeight + ATLAS_PADDING);
+
+    unsigned char* pixels = (unsigned char*) calloc(4 * atlas->width * atlas->height, 1);
+    if(pixels == NULL) {
+        return 0;
+    }
+    for(i = 0; i < NB_GLYPHS; ++i) {
+        if(images[i].pixels == NULL) {
+            memset(&atlas->glyphs[i], 0, sizeof(Glyph));
+            continue;
+        }
+        for(j = 0; j < images[i].height; ++j) {
+            memcpy(pixels + 4 * ((posY[i] + j) * atlas->width + posX[i]), images[i].pixels + 4 * j * images[i].width, 4 * images[i].width);
+        }
+        atlas->glyphs[i].u0 = (float) posX[i] / atlas->width;
+        atlas->glyphs[i].v0 = (float) posY[i] / atlas->height;
+        atlas->glyphs[i].u1 = (float) (posX[i] + images[i].width) / atlas->width;
+        atlas->glyphs[i].v1 = (float) (posY[i] + images[i].height) / atlas->height;
+        atlas->glyphs[i].aspect = (float) images[i].width / images[i].height;
+    }
+
+    glGenTextures(1, &atlas->texture);
+    glBindTexture(GL_TEXTURE_2D, atlas->texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, atlas->width, atlas->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    free(pixels);
+    return 1;
+}
+
+void deleteGlyphAtlas(GlyphAtlas* atlas) {
+    glDeleteTextures(1, &atlas->texture);
+    atlas->texture = 0;
 }
 
-const char* filename = "logo_imac_400x400.jpg";
+const Glyph* findGlyph(const GlyphAtlas* atlas, char c) {
+    const char* found = c ? strchr(GLYPH_CHARS, c) : NULL;
+    return found ? &atlas->glyphs[found - GLYPH_CHARS] : NULL;
+}
+
+float stringWidth(const GlyphAtlas* atlas, const char* text, float height) {
+    float width = 0;
+    for(; *text; ++text) {
+        const Glyph* glyph = findGlyph(atlas, *text);
+        if(glyph) {
+            width += height * glyph->aspect;
+        }
+    }
+    return width;
+}
+
+// Dessine une chaîne à partir de (x, y), coin bas gauche : tous les quads dans un seul tableau, un seul appel de dessin.
+// Les caractères absents de l'atlas sont ignorés.
+void drawString(const GlyphAtlas* atlas, const char* text, float x, float y, float height) {
+    static GLfloat vertices[4 * 4 * MAX_STRING_LENGTH]; // x, y, u, v pour les 4 sommets de chaque glyphe
+    GLfloat* v = vertices;
+    int count = 0;
 
-void glGenTextures(GLsizei 1, GLuint* textures){
-// 1 correspond au nombre de texture qu'on veut générer
+    for(; *text && count < MAX_STRING_LENGTH; ++text) {
+        const Glyph* glyph = findGlyph(atlas, *text);
+        if(glyph == NULL) {
+            continue;
+        }
+        float width = height * glyph->aspect;
+        // La première ligne de l'image est en haut du glyphe
+        *v++ = x;         *v++ = y + height; *v++ = glyph->u0; *v++ = glyph->v0;
+        *v++ = x + width; *v++ = y + height; *v++ = glyph->u1; *v++ = glyph->v0;
+        *v++ = x + width; *v++ = y;          *v++ = glyph->u1; *v++ = glyph->v1;
+        *v++ = x;         *v++ = y;          *v++ = glyph->u0; *v++ = glyph->v1;
+        x += width;
+        count++;
+    }
 
+    glEnable(GL_TEXTURE_2D);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glBindTexture(GL_TEXTURE_2D, atlas->texture);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glVertexPointer(2, GL_FLOAT, 4 * sizeof(GLfloat), vertices);
+    glTexCoordPointer(2, GL_FLOAT, 4 * sizeof(GLfloat), vertices + 2);
+    glDrawArrays(GL_QUADS, 0, 4 * count);
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glDisable(GL_BLEND);
+    glDisable(GL_TEXTURE_2D);
+}
+
+// Chargeur d'images asynchrone : LOADER_THREADS threads décodent les fichiers (IMG_Load et conversion RGBA)
+// pendant que la fenêtre s'affiche ; les images prêtes passent par une file et le thread OpenGL, seul à
+// pouvoir appeler glTexImage2D, les envoie à la carte graphique au fil des frames
+#define LOADER_THREADS 4
+#define MAX_UPLOADS_PER_FRAME 2 // textures envoyées par frame au plus, pour ne pas faire sauter d'image
+
+typedef struct ImageLoader {
+    const char** files;
+    int nbFiles;
+    Image* images; // une case par fichier, écrite par le seul thread qui le décode
+    int* ready; // file des indices décodés, dans l'ordre où ils ont fini
+    int nbReady, nbTaken;
+    int nextFile; // prochain fichier à décoder
+    int quit;
+    SDL_mutex* mutex; // protège ready, nbReady, nextFile et quit
+    SDL_Thread* threads[LOADER_THREADS];
+    int nbThreads;
+} ImageLoader;
+
+void stopImageLoader(ImageLoader* loader);
+
+int loaderThread(void* data) {
+    ImageLoader* loader = (ImageLoader*) data;
+    for(;;) {
+        SDL_mutexP(loader->mutex);
+        if(loader->quit || loader->nextFile == loader->nbFiles) {
+            SDL_mutexV(loader->mutex);
+            return 0;
+        }
+        int i = loader->nextFile++;
+        SDL_mutexV(loader->mutex);
+
+        // Le décodage, long, se fait hors du verrou : les threads avancent en parallèle
+        decodeImage(loader->files[i], &loader->images[i]);
+
+        SDL_mutexP(loader->mutex);
+        loader->ready[loader->nbReady++] = i;
+        SDL_mutexV(loader->mutex);
+    }
+}
+
+// Lance le décodage des fichiers. Renvoie 0 si aucun thread n'a pu démarrer.
+int startImageLoader(ImageLoader* loader, const char** files, int nbFiles) {
+    memset(loader, 0, sizeof(ImageLoader));
+    loader->files = files;
+    loader->nbFiles = nbFiles;
+    loader->images = (Image*) calloc(nbFiles, sizeof(Image));
+    loader->ready = (int*) malloc(nbFiles * sizeof(int));
+    loader->mutex = SDL_CreateMutex();
+    if(loader->images == NULL || loader->ready == NULL || loader->mutex == NULL) {
+        stopImageLoader(loader);
+        return 0;
+    }
+    while(loader->nbThreads < LOADER_THREADS && loader->nbThreads < nbFiles) {
+        SDL_Thread* thread = SDL_CreateThread(loaderThread, loader);
+        if(thread == NULL) {
+            break;
+        }
+        loader->threads[loader->nbThreads++] = thread;
+    }
+    if(loader->nbThreads == 0) {
+        stopImageLoader(loader);
+        return 0;
+    }
+    return 1;
+}
+
+// Renvoie l'indice du prochain fichier décodé et pas encore récupéré, ou -1 s'il n'y en a pas.
+// Si le chargement a échoué, loader->images[i].pixels vaut NULL.
+int nextLoadedImage(ImageLoader* loader) {
+    int i = -1;
+    SDL_mutexP(loader->mutex);
+    if(loader->nbTaken < loader->nbReady) {
+        i = loader->ready[loader->nbTaken++];
+    }
+    SDL_mutexV(loader->mutex);
+    return i;
+}
+
+// Arrête les threads (ceux en plein décodage finissent leur image) et libère les images non récupérées
+void stopImageLoader(ImageLoader* loader) {
+    int i;
+    if(loader->mutex) {
+        SDL_mutexP(loader->mutex);
+        loader->quit = 1;
+        SDL_mutexV(loader->mutex);
+    }
+    for(i = 0; i < loader->nbThreads; ++i) {
+        SDL_WaitThread(loader->threads[i], NULL);
+    }
+    loader->nbThreads = 0;
+    if(loader->images) {
+        for(i = 0; i < loader->nbFiles; ++i) {
+            freeImage(&loader->images[i]);
+        }
+    }
+    free(loader->images);
+    free(loader->ready);
+    loader->images = NULL;
+    loader->ready = NULL;
+    if(loader->mutex) {
+        SDL_DestroyMutex(loader->mutex);
+        loader->mutex = NULL;
+    }
+}
+
+// Envoie une image à OpenGL avec toute sa chaîne de mipmaps, générée par la carte, et un filtrage trilinéaire :
+// réduit, le logo reste lisse au lieu de scintiller, et ne lit que le niveau de la taille affichée
+GLuint uploadTexture(const Image* image) {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_GENERATE_MIPMAP, GL_TRUE);
+    // Lignes serrées de 4 * width octets : l'alignement par défaut (4) convient, on le remet au cas où
+    // un autre envoi l'aurait changé
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, image->width, image->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image->pixels);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texture;
+}
+
+// Dessine une texture dans le rectangle (x0, y0) - (x1, y1), la première ligne de l'image en haut
+void drawTexture(GLuint texture, float x0, float y0, float x1, float y1) {
+    glEnable(GL_TEXTURE_2D);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glBegin(GL_QUADS);
+    glTexCoord2f(0, 0); glVertex2f(x0, y1);
+    glTexCoord2f(1, 0); glVertex2f(x1, y1);
+    glTexCoord2f(1, 1); glVertex2f(x1, y0);
+    glTexCoord2f(0, 1); glVertex2f(x0, y0);
+    glEnd();
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glDisable(GL_BLEND);
+    glDisable(GL_TEXTURE_2D);
+}
+
+// Scène du banc d'essai propre à tp4 : des horloges dessinées avec l'atlas des glyphes, un quad texturé par caractère
+#define BENCH_STRINGS 1000 // chaînes dessinées par image
+#define BENCH_STRING_HEIGHT 0.05f
+static const char* BENCH_STRING = "12:34:56";
+
+typedef struct BenchStrings {
+    const GlyphAtlas* atlas;
+    float x[BENCH_STRINGS], y[BENCH_STRINGS];
+} BenchStrings;
+
+void benchDrawStrings(void* data) {
+    const BenchStrings* strings = (const BenchStrings*) data;
+    int i;
+    glColor3ub(255, 255, 255);
+    for(i = 0; i < BENCH_STRINGS; ++i) {
+        drawString(strings->atlas, BENCH_STRING, strings->x[i], strings->y[i], BENCH_STRING_HEIGHT);
+    }
+}
+
+// Les glyphes sont décodés ici, sans les threads de chargement ; une image manquante arrête la scène
+void benchGlyphAtlas() {
+    BenchResult result = {"glyph_atlas", "strings", 0, BENCH_STRINGS, 0, 0, 0, 0};
+    Image images[NB_GLYPHS];
+    GlyphAtlas atlas;
+    BenchStrings strings;
+    int i, decoded = 1;
+
+    long long start = getTimeNanoseconds();
+    for(i = 0; i < NB_GLYPHS; ++i) {
+        decoded &= decodeImage(GLYPH_FILES[i], &images[i]);
+    }
+    result.buildMs = elapsedMilliseconds(start);
+    if(!decoded) {
+        fprintf(stderr, "Impossible de charger les chiffres, scène %s ignorée\n", result.scene);
+        for(i = 0; i < NB_GLYPHS; ++i) {
+            freeImage(&images[i]);
+        }
+        return;
+    }
+
+    start = getTimeNanoseconds();
+    int built = buildGlyphAtlas(&atlas, images);
+    glFinish();
+    result.uploadMs = elapsedMilliseconds(start);
+    for(i = 0; i < NB_GLYPHS; ++i) {
+        freeImage(&images[i]);
+    }
+    if(!built) {
+        fprintf(stderr, "Impossible de construire l'atlas des chiffres, scène %s ignorée\n", result.scene);
+        return;
+    }
+
+    strings.atlas = &atlas;
+    benchSeed = 1;
+    for(i = 0; i < BENCH_STRINGS; ++i) {
+        strings.x[i] = benchRandom() * 0.8;
+        strings.y[i] = benchRandom() * 0.95;
+    }
+    result.drawMs = benchDraw(benchDrawStrings, &strings);
+    result.vertices = 4 * strlen(BENCH_STRING) * BENCH_STRINGS;
+    result.memory = 4 * atlas.width * atlas.height + sizeof(strings);
+    printBenchResult(&result);
+    deleteGlyphAtlas(&atlas);
+}
+
+// Options communes (voir parseCommonArgument())
+void parseArguments(int argc, char** argv) {
+    int i;
+    for(i = 1; i < argc; ++i) {
+        if(!parseCommonArgument(argc, argv, &i)) {
+            fprintf(stderr, "Option inconnue : %s\n", argv[i]);
+        }
+    }
 }
 
 int main(int argc, char** argv) {
 
-    // Initialisation de la SDL
-    if(-1 == SDL_Init(SDL_INIT_VIDEO)) {
+    // Fenêtre carrée, comme les logos
+    WINDOW_WIDTH = WINDOW_HEIGHT = 800;
+    parseArguments(argc, argv);
+
+    // Initialisation de la SDL (sans la vidéo en mode sans fenêtre)
+    if(-1 == SDL_Init(headless ? 0 : SDL_INIT_VIDEO)) {
         fprintf(stderr, "Impossible d'initialiser la SDL. Fin du programme.\n");
         return EXIT_FAILURE;
     }
 
-    // Ouverture d'une fenêtre et création d'un contexte OpenGL
-    if(NULL == SDL_SetVideoMode(WINDOW_WIDTH, WINDOW_HEIGHT, BIT_PER_PIXEL, SDL_OPENGL | SDL_RESIZABLE)) {
-        fprintf(stderr, "Impossible d'ouvrir la fenetre. Fin du programme.\n");
-        return EXIT_FAILURE;
+    if(headless) {
+        // Création d'un contexte OpenGL hors écran
+        if(!createHeadlessContext(WINDOW_WIDTH, WINDOW_HEIGHT)) {
+            fprintf(stderr, "Impossible de créer le contexte hors écran. Fin du programme.\n");
+            SDL_Quit();
+            return EXIT_FAILURE;
+        }
+    } else {
+        // Ouverture d'une fenêtre et création d'un contexte OpenGL
+        SDL_GL_SetAttribute(SDL_GL_SWAP_CONTROL, vsync);
+        if(NULL == SDL_SetVideoMode(WINDOW_WIDTH, WINDOW_HEIGHT, BIT_PER_PIXEL, SDL_OPENGL | SDL_RESIZABLE)) {
+            fprintf(stderr, "Impossible d'ouvrir la fenetre. Fin du programme.\n");
+            return EXIT_FAILURE;
+        }
+        SDL_WM_SetCaption("td04", NULL);
     }
-    SDL_WM_SetCaption("td04", NULL);
     resizeViewport();
 
-    // TODO: Chargement et traitement de la texture
-	SDL_Surface* tab_img[10];
-	tab_img[0] = IMG_Load(filename);
-	if(tab_img[0]==NULL){
-		fprintf(stderr, "Le pointeur est NULL, déso.\n");
-	        return EXIT_FAILURE;
-	}
-
-	GLuint textureID;
-	glGenTextures(1,&textureID);
+    // Chargement des textures en arrière-plan : les glyphes de l'horloge puis les logos.
+    // La boucle de dessin démarre tout de suite et affiche chaque texture dès qu'elle arrive.
+    const char* files[NB_GLYPHS + NB_LOGOS];
+    int i;
+    for(i = 0; i < NB_GLYPHS; ++i) {
+        files[i] = GLYPH_FILES[i];
+    }
+    for(i = 0; i < NB_LOGOS; ++i) {
+        files[NB_GLYPHS + i] = LOGO_FILES[i];
+    }
+    // SDL_image charge ses décodeurs au premier IMG_Load(), ce qui n'est pas sûr depuis plusieurs threads :
+    // on les charge ici, avant de lancer les threads de chargement
+    const int imageFormats = IMG_INIT_PNG | IMG_INIT_JPG;
+    if((IMG_Init(imageFormats) & imageFormats) != imageFormats) {
+        fprintf(stderr, "Impossible d'initialiser SDL_image (%s). Fin du programme.\n", IMG_GetError());
+        IMG_Quit();
+        destroyHeadlessContext();
+        SDL_Quit();
+        return EXIT_FAILURE;
+    }
+    // Banc d'essai : la scène synthétique remplace la boucle de dessin
+    if(benchmark) {
+        beginBenchmark("tp4");
+        benchGlyphAtlas();
+    }
 
-    // ...
+    ImageLoader loader;
+    if(!startImageLoader(&loader, files, NB_GLYPHS + NB_LOGOS)) {
+        fprintf(stderr, "Impossible de lancer le chargement des images. Fin du programme.\n");
+        IMG_Quit();
+        destroyHeadlessContext();
+        SDL_Quit();
+        return EXIT_FAILURE;
+    }
+    int nbGlyphs = 0;
+    int nbArrived = 0;
 
-    // TODO: Libération des données CPU
-	SDL_FreeSurface(tab_img[0]);
-    // ...
+    GlyphAtlas atlas;
+    atlas.texture = 0;
+    GLuint textures[NB_LOGOS] = {0};
 
-    /* Boucle de dessin (à décommenter pour l'exercice 3)
-    int loop = 1;
+    // Boucle de dessin
+    int loop = !benchmark;
+    FrameScheduler scheduler;
+    initFrameScheduler(&scheduler);
     glClearColor(0.1, 0.1, 0.1 ,1.0);
     while(loop) {
 
-        Uint32 startTime = SDL_GetTicks();
+        // Envoi à OpenGL des images décodées depuis la frame précédente.
+        // Sans fenêtre, tout est envoyé avant la première image : les images écrites ne dépendent pas de la
+        // vitesse des threads de chargement.
+        int uploads = 0;
+        while((headless || uploads < MAX_UPLOADS_PER_FRAME) && (i = nextLoadedImage(&loader)) >= 0) {
+            nbArrived++;
+            Image* image = &loader.images[i];
+            if(image->pixels == NULL) {
+                fprintf(stderr, "Impossible de charger %s\n", files[i]);
+            }
+            if(i < NB_GLYPHS) {
+                // L'atlas n'est construit qu'une fois tous les chiffres arrivés, qu'ils aient pu être chargés ou non
+                if(++nbGlyphs == NB_GLYPHS) {
+                    if(!buildGlyphAtlas(&atlas, loader.images)) {
+                        fprintf(stderr, "Impossible de construire l'atlas des chiffres\n");
+                    }
+                    for(i = 0; i < NB_GLYPHS; ++i) {
+                        freeImage(&loader.images[i]);
+                    }
+                    uploads++;
+                }
+            } else if(image->pixels != NULL) {
+                textures[i - NB_GLYPHS] = uploadTexture(image);
+                freeImage(image);
+                uploads++;
+            }
+        }
 
-        // TODO: Code de dessin
+        if(headless && nbArrived < NB_GLYPHS + NB_LOGOS) {
+            SDL_Delay(1);
+            continue;
+        }
 
         glClear(GL_COLOR_BUFFER_BIT);
 
-        // ...
+        // Logos côte à côte en haut de la fenêtre
+        glColor3ub(255, 255, 255);
+        for(i = 0; i < NB_LOGOS; ++i) {
+            if(textures[i]) {
+                float x = -0.9 + i * 0.95;
+                drawTexture(textures[i], x, 0.2, x + 0.85, 0.2 + 0.85);
+            }
+        }
+
+        // Horloge au centre de la fenêtre
+        if(atlas.texture) {
+            char clock[MAX_STRING_LENGTH];
+            time_t now = time(NULL);
+            strftime(clock, sizeof(clock), "%H:%M:%S", localtime(&now));
+            drawString(&atlas, clock, -stringWidth(&atlas, clock, 0.2) / 2, -0.1, 0.2);
+        }
 
         // Fin du code de dessin
 
@@ -92,16 +643,24 @@ int main(int argc, char** argv) {
             }
         }
 
-        SDL_GL_SwapBuffers();
-        Uint32 elapsedTime = SDL_GetTicks() - startTime;
-        if(elapsedTime < FRAMERATE_MILLISECONDS) {
-            SDL_Delay(FRAMERATE_MILLISECONDS - elapsedTime);
+        swapBuffers();
+        if(headless) {
+            // Sans fenêtre, on s'arrête au nombre d'images demandé
+            if(frameNumber >= headlessFrames) {
+                loop = 0;
+            }
+        } else {
+            waitNextFrame(&scheduler);
         }
     }
-    */
 
-    // TODO: Libération des données GPU
-    	glDeleteTextures(1,&textureID);
+    stopImageLoader(&loader);
+    IMG_Quit();
+
+    // Libération des données GPU
+    glDeleteTextures(NB_LOGOS, textures);
+    deleteGlyphAtlas(&atlas);
+    destroyHeadlessContext();
     // Liberation des ressources associées à la SDL
     SDL_Quit();
 